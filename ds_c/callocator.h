@@ -0,0 +1,333 @@
+/*  callocator.h
+ *  A pluggable allocator interface for the containers, with bump-arena and huge-page allocators.
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The huge-page allocator needs the Linux mmap() extensions (e.g. through _DEFAULT_SOURCE).
+#if defined(__linux__)
+#include <sys/mman.h>
+#if defined(MAP_ANONYMOUS) && defined(MAP_HUGETLB) && defined(MADV_HUGEPAGE)
+#define CALLOCATOR_HAS_HUGE 1
+#endif
+#endif
+
+// Utility macros.
+#define _CASTCINL static inline
+#define _CAREQUIRE(condition, action)                                                              \
+    do {                                                                                           \
+        if (!(condition)) {                                                                        \
+            action;                                                                                \
+        }                                                                                          \
+    } while (0)
+#define _CAFALSE 0
+#define _CATRUE 1
+
+#define _CA_MIN_ALIGN _Alignof(max_align_t)
+#define _CA_MIN_CHUNK ((size_t)4096)
+#define _CA_MAX_CHUNK ((size_t)1 << 22)
+#define _CA_HUGE_PAGE ((size_t)1 << 21)
+#define _CA_HUGE_MIN (_CA_HUGE_PAGE / 2) // Smaller blocks are not worth a huge page of their own.
+
+/*
+    Allocator interface of the containers. Every function receives `ctx`. Blocks are aligned to at
+    least `_Alignof(max_align_t)`, or to `align` if that is a larger power of two, and are freed
+    and resized with the size they were last given (as with cpool_free()). Resized blocks only keep
+    the default alignment. Wherever an allocator is accepted, `NULL` selects malloc() and free().
+    Containers call their allocator from every thread that modifies them, so a container shared
+    between threads needs a thread-safe one. The arena allocator is not.
+*/
+typedef struct {
+    void *(*alloc_func)(void *ctx, size_t size, size_t align);
+    void *(*realloc_func)(void *ctx, void *block, size_t old_size, size_t new_size);
+    void (*free_func)(void *ctx, void *block, size_t size);
+    void *ctx;
+} callocator_t;
+
+// Allocates a block of at least `size` bytes through an allocator.
+_CASTCINL void *callocator_alloc(const callocator_t *allocator, size_t size, size_t align) {
+    if (allocator) {
+        return allocator->alloc_func(allocator->ctx, size, align);
+    }
+    if (align <= _CA_MIN_ALIGN) {
+        return malloc(size);
+    }
+    _CAREQUIRE(size <= SIZE_MAX - align, return NULL);
+    return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+}
+
+// Allocates a zeroed array through an allocator.
+_CASTCINL void *callocator_calloc(const callocator_t *allocator, size_t count, size_t size) {
+    _CAREQUIRE(!size || count <= SIZE_MAX / size, return NULL);
+    if (!allocator) {
+        return calloc(count, size); // Keeps fresh pages from the OS untouched.
+    }
+    void *block = allocator->alloc_func(allocator->ctx, count * size, _CA_MIN_ALIGN);
+    _CAREQUIRE(block, return NULL);
+    memset(block, 0, count * size);
+    return block;
+}
+
+// Resizes a block through an allocator. A `NULL` block is allocated.
+_CASTCINL void *
+callocator_realloc(const callocator_t *allocator, void *block, size_t old_size, size_t new_size) {
+    if (allocator) {
+        return allocator->realloc_func(allocator->ctx, block, old_size, new_size);
+    }
+    return realloc(block, new_size);
+}
+
+// Frees a block through an allocator. `size` must match the size it was allocated with.
+_CASTCINL void callocator_free(const callocator_t *allocator, void *block, size_t size) {
+    _CAREQUIRE(block, return);
+    if (allocator) {
+        allocator->free_func(allocator->ctx, block, size);
+    } else {
+        free(block);
+    }
+}
+
+// Chunk header, followed by the memory that an arena bumps through.
+typedef struct callocator_chunk {
+    struct callocator_chunk *_next;
+    size_t _size; // Usable bytes after the header.
+    size_t _used;
+    _Alignas(max_align_t) char _data[];
+} callocator_chunk_t;
+
+/*
+    Bump-arena allocator. Allocation bumps a pointer through the current chunk, and freeing is a
+    no-op except for the latest block, which also resizes in place. callocator_arena_reset()
+    releases every block at once: containers allocated from the arena are then dropped without
+    being uninitialized, and their destructors never run.
+*/
+typedef struct {
+    callocator_t _allocator; // Passed to the containers. Its context is the arena itself.
+    callocator_chunk_t *_chunks; // The head is the chunk currently being bumped through.
+    void *_last;                 // Latest block of the head chunk, or NULL.
+    size_t _next_chunk_size;
+    size_t _chunk_count;
+} callocator_arena_t;
+
+// Links a new chunk of at least `min_size` usable bytes. Oversized chunks go behind the head, which
+// keeps being bumped through.
+_CASTCINL callocator_chunk_t *_callocator_arena_chunk(callocator_arena_t *arena, size_t min_size) {
+    const _Bool dedicated = min_size > arena->_next_chunk_size;
+    const size_t size = dedicated ? min_size : arena->_next_chunk_size;
+    _CAREQUIRE(size <= SIZE_MAX - sizeof(callocator_chunk_t), return NULL);
+    callocator_chunk_t *chunk = malloc(sizeof(callocator_chunk_t) + size);
+    _CAREQUIRE(chunk, return NULL);
+    chunk->_size = size;
+    chunk->_used = 0;
+    if (dedicated && arena->_chunks) {
+        chunk->_next = arena->_chunks->_next;
+        arena->_chunks->_next = chunk;
+    } else {
+        chunk->_next = arena->_chunks;
+        arena->_chunks = chunk;
+        arena->_last = NULL;
+    }
+    ++arena->_chunk_count;
+    if (!dedicated && arena->_next_chunk_size < _CA_MAX_CHUNK) {
+        arena->_next_chunk_size *= 2; // Chunks grow geometrically, so small arenas stay small.
+    }
+    return chunk;
+}
+
+_CASTCINL void *_callocator_arena_alloc(void *ctx, size_t size, size_t align) {
+    callocator_arena_t *arena = (callocator_arena_t *)ctx;
+    align = align > _CA_MIN_ALIGN ? align : _CA_MIN_ALIGN;
+    _CAREQUIRE(size <= SIZE_MAX / 2 - align, return NULL);
+    callocator_chunk_t *chunk = arena->_chunks;
+    if (chunk) {
+        const uintptr_t base = (uintptr_t)chunk->_data;
+        const size_t offset = ((base + chunk->_used + align - 1) & ~(uintptr_t)(align - 1)) - base;
+        if (offset <= chunk->_size && chunk->_size - offset >= size) {
+            chunk->_used = offset + size;
+            arena->_last = chunk->_data + offset;
+            return arena->_last;
+        }
+    }
+    chunk = _callocator_arena_chunk(arena, size + align);
+    _CAREQUIRE(chunk, return NULL);
+    const uintptr_t base = (uintptr_t)chunk->_data;
+    const size_t offset = ((base + align - 1) & ~(uintptr_t)(align - 1)) - base;
+    chunk->_used = offset + size;
+    if (chunk == arena->_chunks) {
+        arena->_last = chunk->_data + offset;
+    }
+    return chunk->_data + offset;
+}
+
+_CASTCINL void *
+_callocator_arena_realloc(void *ctx, void *block, size_t old_size, size_t new_size) {
+    callocator_arena_t *arena = (callocator_arena_t *)ctx;
+    _CAREQUIRE(block, return _callocator_arena_alloc(ctx, new_size, _CA_MIN_ALIGN));
+    if (block == arena->_last) {
+        callocator_chunk_t *chunk = arena->_chunks;
+        const size_t offset = (size_t)((char *)block - chunk->_data);
+        if (chunk->_size - offset >= new_size) {
+            chunk->_used = offset + new_size;
+            return block;
+        }
+    } else if (new_size <= old_size) {
+        return block;
+    }
+    void *nblock = _callocator_arena_alloc(ctx, new_size, _CA_MIN_ALIGN);
+    _CAREQUIRE(nblock, return NULL);
+    memcpy(nblock, block, old_size < new_size ? old_size : new_size);
+    return nblock;
+}
+
+_CASTCINL void _callocator_arena_free(void *ctx, void *block, size_t size) {
+    callocator_arena_t *arena = (callocator_arena_t *)ctx;
+    (void)size;
+    if (block == arena->_last) {
+        arena->_chunks->_used = (size_t)((char *)block - arena->_chunks->_data);
+        arena->_last = NULL;
+    }
+}
+
+// Initializes a given pointer with an arena. Chunks start at `chunk_size` bytes (0 for a default)
+// and double as the arena grows. No chunk is allocated until first use.
+_CASTCINL _Bool callocator_arena_init(callocator_arena_t **arena, size_t chunk_size) {
+    _CAREQUIRE(arena, return _CAFALSE);
+    callocator_arena_t *carena = malloc(sizeof(callocator_arena_t));
+    _CAREQUIRE(carena, return _CAFALSE);
+    *carena = (callocator_arena_t){._allocator = {.alloc_func = _callocator_arena_alloc,
+                                                  .realloc_func = _callocator_arena_realloc,
+                                                  .free_func = _callocator_arena_free,
+                                                  .ctx = carena},
+                                   ._chunks = NULL,
+                                   ._last = NULL,
+                                   ._next_chunk_size = chunk_size ? chunk_size : _CA_MIN_CHUNK,
+                                   ._chunk_count = 0};
+    *arena = carena;
+    return _CATRUE;
+}
+
+// Releases every block of an arena at once. The latest chunk is kept and bumped through again.
+_CASTCINL void callocator_arena_reset(callocator_arena_t **arena) {
+    _CAREQUIRE(arena && *arena, return);
+    callocator_arena_t *carena = *arena;
+    _CAREQUIRE(carena->_chunks, return);
+    callocator_chunk_t *chunk = carena->_chunks->_next;
+    while (chunk) {
+        callocator_chunk_t *next = chunk->_next;
+        free(chunk);
+        chunk = next;
+    }
+    carena->_chunks->_next = NULL;
+    carena->_chunks->_used = 0;
+    carena->_last = NULL;
+    carena->_chunk_count = 1;
+}
+
+// Uninitializes a pointer to an arena, releasing every block and chunk.
+_CASTCINL void callocator_arena_uninit(callocator_arena_t **arena) {
+    _CAREQUIRE(arena && *arena, return);
+    callocator_chunk_t *chunk = (*arena)->_chunks;
+    while (chunk) {
+        callocator_chunk_t *next = chunk->_next;
+        free(chunk);
+        chunk = next;
+    }
+    free(*arena);
+    *arena = NULL;
+}
+
+// Returns the allocator to hand to the containers allocating from an arena.
+_CASTCINL const callocator_t *callocator_arena(callocator_arena_t *arena) {
+    return &arena->_allocator;
+}
+
+#if defined(CALLOCATOR_HAS_HUGE)
+// Returns the mapped size of a block served by the huge-page allocator, or 0 for a malloc() one.
+_CASTCINL size_t _callocator_huge_size(size_t size) {
+    return size < _CA_HUGE_MIN ? 0 : (size + _CA_HUGE_PAGE - 1) & ~(_CA_HUGE_PAGE - 1);
+}
+
+// Maps `size` bytes (a multiple of the huge page size) aligned to a huge page. Explicit huge pages
+// are used if the system reserved some, else transparent ones are requested.
+_CASTCINL void *_callocator_huge_map(size_t size) {
+    const int prot = PROT_READ | PROT_WRITE;
+    void *block = mmap(NULL, size, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (block != MAP_FAILED) {
+        return block;
+    }
+    // Over-maps by a page to trim down to an aligned range, which transparent huge pages need.
+    _CAREQUIRE(size <= SIZE_MAX - _CA_HUGE_PAGE, return NULL);
+    char *raw = mmap(NULL, size + _CA_HUGE_PAGE, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    _CAREQUIRE(raw != MAP_FAILED, return NULL);
+    const uintptr_t mask = ~(uintptr_t)(_CA_HUGE_PAGE - 1);
+    char *aligned = (char *)(((uintptr_t)raw + _CA_HUGE_PAGE - 1) & mask);
+    if (aligned != raw) {
+        munmap(raw, (size_t)(aligned - raw));
+    }
+    munmap(aligned + size, (size_t)(raw + _CA_HUGE_PAGE - aligned)); // Never empty.
+    madvise(aligned, size, MADV_HUGEPAGE);
+    return aligned;
+}
+
+_CASTCINL void *_callocator_huge_alloc(void *ctx, size_t size, size_t align) {
+    (void)ctx;
+    const size_t mapped = _callocator_huge_size(size);
+    if (mapped && align <= _CA_HUGE_PAGE) {
+        return _callocator_huge_map(mapped);
+    }
+    _CAREQUIRE(!mapped, return NULL); // Mapped blocks are freed by their size, whatever the align.
+    return callocator_alloc(NULL, size, align);
+}
+
+_CASTCINL void _callocator_huge_free(void *ctx, void *block, size_t size) {
+    (void)ctx;
+    const size_t mapped = _callocator_huge_size(size);
+    if (mapped) {
+        munmap(block, mapped);
+    } else {
+        free(block);
+    }
+}
+
+_CASTCINL void *_callocator_huge_realloc(void *ctx, void *block, size_t old_size, size_t new_size) {
+    const size_t old_mapped = _callocator_huge_size(old_size);
+    const size_t new_mapped = _callocator_huge_size(new_size);
+    _CAREQUIRE(block, return _callocator_huge_alloc(ctx, new_size, _CA_MIN_ALIGN));
+    if (!old_mapped && !new_mapped) {
+        return realloc(block, new_size);
+    }
+    if (old_mapped == new_mapped) {
+        return block;
+    }
+    void *nblock = _callocator_huge_alloc(ctx, new_size, _CA_MIN_ALIGN);
+    _CAREQUIRE(nblock, return NULL);
+    memcpy(nblock, block, old_size < new_size ? old_size : new_size);
+    _callocator_huge_free(ctx, block, old_size);
+    return nblock;
+}
+
+/*
+    Huge-page allocator. Blocks of at least half a 2 MiB huge page are mapped on their own, in
+    whole huge pages, which cuts the TLB misses of large tables. Smaller blocks come from malloc().
+    Thread-safe.
+*/
+static const callocator_t callocator_huge = {.alloc_func = _callocator_huge_alloc,
+                                             .realloc_func = _callocator_huge_realloc,
+                                             .free_func = _callocator_huge_free,
+                                             .ctx = NULL};
+#endif
+
+// Macro API accessors.
+#define CALLOCATOR_ARENA_CHUNK_COUNT(arena) (arena->_chunk_count)
+
+// Macro API functions.
+#define CALLOCATOR_ARENA_INIT(arena, chunk_size) (callocator_arena_init(&arena, chunk_size))
+#define CALLOCATOR_ARENA_UNINIT(arena) (callocator_arena_uninit(&arena))
+#define CALLOCATOR_ARENA_RESET(arena) (callocator_arena_reset(&arena))
+#define CALLOCATOR_ARENA(arena) (callocator_arena(arena))
@@ -0,0 +1,305 @@
+/*  ccache.h
+ *  A bounded CLOCK cache on top of cmap.h, limited by entry count and/or total charge (bytes).
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+#include "cmap.h"
+
+// Implementation detail. A cached entry, in a slot array that the clock hand sweeps.
+typedef struct {
+    void *key;
+    void *value;
+    size_t charge; // Links the free slots together while the slot is unused.
+    _Bool referenced;
+    _Bool used;
+} _ccache_slot_t;
+
+typedef struct {
+    cmap_t *_index; // Key to slot index, with the cache's key size, hash and comparison functions.
+    _ccache_slot_t *_slots;
+    size_t _slot_capacity;
+    size_t _slot_count; // Slots handed out at least once. Those below it are used or free.
+    size_t _free_slot;  // First free slot below `_slot_count`, or SIZE_MAX.
+    size_t _hand;       // Next slot the clock examines.
+    size_t _size;
+    size_t _charge; // Sum of the charges of every entry.
+    size_t _max_entries; // 0 for no limit.
+    size_t _max_charge;  // 0 for no limit.
+    size_t _hits;
+    size_t _misses;
+    size_t _evictions;
+    void (*_key_destructor)(void **); // Also called on eviction.
+    void (*_val_destructor)(void **); // Also called on eviction, and on replaced values.
+    const callocator_t *_allocator;   // Allocates the cache, its slots and its index.
+} ccache_t;
+
+// Destroys the entry of a slot and returns the slot to the free list.
+_CMSTCINL void _ccache_release(ccache_t *cache, _ccache_slot_t *slot) {
+    if (cache->_key_destructor) {
+        cache->_key_destructor(&slot->key);
+    }
+    if (cache->_val_destructor) {
+        cache->_val_destructor(&slot->value);
+    }
+    cache->_charge -= slot->charge;
+    --cache->_size;
+    slot->used = _CMFALSE;
+    slot->charge = cache->_free_slot;
+    cache->_free_slot = (size_t)(slot - cache->_slots);
+}
+
+// Evicts the first entry the clock hand finds unreferenced, clearing the reference bits it passes.
+// The slot `keep` (or SIZE_MAX for none) is passed over. Takes at most two sweeps. The cache must
+// hold an entry other than `keep`.
+_CMSTCINL void _ccache_evict(ccache_t *cache, size_t keep) {
+    for (;;) {
+        const size_t idx = cache->_hand;
+        _ccache_slot_t *slot = &cache->_slots[idx];
+        cache->_hand = cache->_hand + 1 == cache->_slot_count ? 0 : cache->_hand + 1;
+        if (!slot->used || idx == keep) {
+            continue;
+        }
+        if (slot->referenced) {
+            slot->referenced = _CMFALSE; // Second chance.
+            continue;
+        }
+        _cmap_remove_hashed(cache->_index, slot->key, cache->_index->_hash_func(slot->key));
+        _ccache_release(cache, slot);
+        ++cache->_evictions;
+        return;
+    }
+}
+
+// Returns the index of a free slot, growing the slot array when the entry count is unbounded.
+_CMSTCINL size_t _ccache_take_slot(ccache_t *cache) {
+    if (cache->_free_slot != SIZE_MAX) {
+        const size_t idx = cache->_free_slot;
+        cache->_free_slot = cache->_slots[idx].charge;
+        return idx;
+    }
+    if (cache->_slot_count == cache->_slot_capacity) {
+        const size_t ncapacity = cache->_slot_capacity * 2;
+        _CMREQUIRE(ncapacity < SIZE_MAX / sizeof(_ccache_slot_t), return SIZE_MAX);
+        _ccache_slot_t *slots = callocator_realloc(
+            cache->_allocator, cache->_slots, cache->_slot_capacity * sizeof(_ccache_slot_t),
+            ncapacity * sizeof(_ccache_slot_t)
+        );
+        _CMREQUIRE(slots, return SIZE_MAX);
+        cache->_slots = slots;
+        cache->_slot_capacity = ncapacity;
+    }
+    return cache->_slot_count++;
+}
+
+/*
+    Initializes a given pointer with a ccache_t instance. At least one of `max_entries` and
+    `max_charge` must be non-zero. With `max_entries`, every slot and the whole index are allocated
+    up front, so no put rehashes. Evicted, removed and remaining entries are destroyed with the
+    given destructors. Every allocation goes through `allocator` (NULL for malloc()).
+*/
+_CMSTCINL _Bool ccache_init_with(
+    ccache_t **cache,
+    size_t key_size,
+    size_t max_entries,
+    size_t max_charge,
+    size_t (*hash_func)(const void *),
+    int (*comparison_func)(const void *, const void *),
+    void (*key_destructor)(void **),
+    void (*val_destructor)(void **),
+    const callocator_t *allocator
+) {
+    _CMREQUIRE(cache && (max_entries || max_charge), return _CMFALSE);
+    const size_t slot_capacity = max_entries ? max_entries : 8;
+    _CMREQUIRE(slot_capacity < SIZE_MAX / sizeof(_ccache_slot_t), return _CMFALSE);
+    const size_t slot_bytes = slot_capacity * sizeof(_ccache_slot_t);
+    ccache_t *ccache = callocator_alloc(allocator, sizeof(ccache_t), 0);
+    _CMREQUIRE(ccache, return _CMFALSE);
+    *ccache = (ccache_t){._index = NULL,
+                         ._slots = callocator_alloc(allocator, slot_bytes, 0),
+                         ._slot_capacity = slot_capacity,
+                         ._slot_count = 0,
+                         ._free_slot = SIZE_MAX,
+                         ._hand = 0,
+                         ._size = 0,
+                         ._charge = 0,
+                         ._max_entries = max_entries,
+                         ._max_charge = max_charge,
+                         ._hits = 0,
+                         ._misses = 0,
+                         ._evictions = 0,
+                         ._key_destructor = key_destructor,
+                         ._val_destructor = val_destructor,
+                         ._allocator = allocator};
+    _CMREQUIRE(
+        ccache->_slots, callocator_free(allocator, ccache, sizeof(ccache_t)); return _CMFALSE
+    );
+    const cmap_options_t options = {.allocator = allocator};
+    if (!cmap_init_ex(
+            &ccache->_index, key_size, sizeof(size_t), 8, hash_func, comparison_func, NULL, NULL,
+            &options
+        ) ||
+        !cmap_reserve(&ccache->_index, max_entries)) {
+        cmap_uninit(&ccache->_index);
+        callocator_free(allocator, ccache->_slots, slot_bytes);
+        callocator_free(allocator, ccache, sizeof(ccache_t));
+        return _CMFALSE;
+    }
+    *cache = ccache;
+    return _CMTRUE;
+}
+
+// Initializes a given pointer with a ccache_t instance. See ccache_init_with().
+_CMSTCINL _Bool ccache_init(
+    ccache_t **cache,
+    size_t key_size,
+    size_t max_entries,
+    size_t max_charge,
+    size_t (*hash_func)(const void *),
+    int (*comparison_func)(const void *, const void *),
+    void (*key_destructor)(void **),
+    void (*val_destructor)(void **)
+) {
+    return ccache_init_with(
+        cache, key_size, max_entries, max_charge, hash_func, comparison_func, key_destructor,
+        val_destructor, NULL
+    );
+}
+
+// Uninitializes a pointer to a ccache_t instance, destroying every entry.
+_CMSTCINL void ccache_uninit(ccache_t **cache) {
+    _CMREQUIRE(cache && *cache, return);
+    ccache_t *ccache = *cache;
+    _CMFOR(i, 0, ccache->_slot_count, 1) {
+        if (ccache->_slots[i].used) {
+            _ccache_release(ccache, &ccache->_slots[i]);
+        }
+    }
+    cmap_uninit(&ccache->_index);
+    callocator_free(
+        ccache->_allocator, ccache->_slots, ccache->_slot_capacity * sizeof(_ccache_slot_t)
+    );
+    callocator_free(ccache->_allocator, ccache, sizeof(ccache_t));
+    *cache = NULL;
+}
+
+// Gets the value of a key and assigns it to an out-parameter, marking the entry as referenced.
+// Never allocates.
+_CMSTCINL _Bool ccache_get(ccache_t **cache, const void *key, void **out) {
+    _CMREQUIRE(cache && *cache && out, return _CMFALSE);
+    ccache_t *ccache = *cache;
+    const cmap_entry_t *entry = _cmap_find(ccache->_index, key, ccache->_index->_hash_func(key));
+    if (!entry) {
+        ++ccache->_misses;
+        return _CMFALSE;
+    }
+    _ccache_slot_t *slot = &ccache->_slots[(size_t)entry->value];
+    slot->referenced = _CMTRUE;
+    *out = slot->value;
+    ++ccache->_hits;
+    return _CMTRUE;
+}
+
+/*
+    Inserts a key-value pair charged `charge` towards the charge limit, evicting entries until it
+    fits. The cache takes ownership of both. If the key is already cached, its value is replaced
+    (the previous value and the new key are destroyed), and it is marked as referenced.
+    Returns `false`, leaving ownership with the caller, if the charge alone exceeds the limit or
+    memory runs out.
+*/
+_CMSTCINL _Bool ccache_put(ccache_t **cache, void *key, void *value, size_t charge) {
+    _CMREQUIRE(cache && *cache, return _CMFALSE);
+    ccache_t *ccache = *cache;
+    _CMREQUIRE(!ccache->_max_charge || charge <= ccache->_max_charge, return _CMFALSE);
+    const size_t hash = ccache->_index->_hash_func(key);
+    const cmap_entry_t *entry = _cmap_find(ccache->_index, key, hash);
+    if (entry) {
+        const size_t idx = (size_t)entry->value; // `entry` moves as evictions update the index.
+        _ccache_slot_t *slot = &ccache->_slots[idx];
+        if (ccache->_key_destructor && slot->key != key) {
+            ccache->_key_destructor(&key);
+        }
+        if (ccache->_val_destructor && slot->value != value) {
+            ccache->_val_destructor(&slot->value);
+        }
+        ccache->_charge = ccache->_charge - slot->charge + charge;
+        slot->value = value;
+        slot->charge = charge;
+        slot->referenced = _CMTRUE;
+        // The new charge may push out other entries, but never this one. Its charge alone fits, so
+        // other entries remain while the limit is exceeded.
+        while (ccache->_max_charge && ccache->_charge > ccache->_max_charge) {
+            _ccache_evict(ccache, idx);
+        }
+        return _CMTRUE;
+    }
+    while (ccache->_size &&
+           ((ccache->_max_entries && ccache->_size >= ccache->_max_entries) ||
+            (ccache->_max_charge && ccache->_charge + charge > ccache->_max_charge))) {
+        _ccache_evict(ccache, SIZE_MAX);
+    }
+    const size_t idx = _ccache_take_slot(ccache);
+    _CMREQUIRE(idx != SIZE_MAX, return _CMFALSE);
+    _cmap_grow_for_insert(ccache->_index); // Without an entry limit, the index is not reserved.
+    if (!_cmap_place(ccache->_index, key, (void *)idx, hash)) {
+        ccache->_slots[idx].charge = ccache->_free_slot;
+        ccache->_slots[idx].used = _CMFALSE;
+        ccache->_free_slot = idx;
+        return _CMFALSE;
+    }
+    ccache->_slots[idx] = (_ccache_slot_t){
+        .key = key, .value = value, .charge = charge, .referenced = _CMFALSE, .used = _CMTRUE
+    };
+    ++ccache->_size;
+    ccache->_charge += charge;
+    return _CMTRUE;
+}
+
+// Removes and destroys the entry of a key. Returns whether the key was cached.
+_CMSTCINL _Bool ccache_remove(ccache_t **cache, const void *key) {
+    _CMREQUIRE(cache && *cache, return _CMFALSE);
+    ccache_t *ccache = *cache;
+    const size_t hash = ccache->_index->_hash_func(key);
+    const cmap_entry_t *entry = _cmap_find(ccache->_index, key, hash);
+    _CMREQUIRE(entry, return _CMFALSE);
+    _ccache_slot_t *slot = &ccache->_slots[(size_t)entry->value];
+    _cmap_remove_hashed(ccache->_index, slot->key, hash);
+    _ccache_release(ccache, slot);
+    return _CMTRUE;
+}
+
+// Evicts one entry by the CLOCK policy, as a put would. Returns `false` if the cache is empty.
+_CMSTCINL _Bool ccache_evict(ccache_t **cache) {
+    _CMREQUIRE(cache && *cache && (*cache)->_size, return _CMFALSE);
+    _ccache_evict(*cache, SIZE_MAX);
+    return _CMTRUE;
+}
+
+// Macro API accessors.
+#define CCACHE_SIZE(cache) (cache->_size)
+#define CCACHE_CHARGE(cache) (cache->_charge)
+#define CCACHE_MAX_ENTRIES(cache) (cache->_max_entries)
+#define CCACHE_MAX_CHARGE(cache) (cache->_max_charge)
+#define CCACHE_HITS(cache) (cache->_hits)
+#define CCACHE_MISSES(cache) (cache->_misses)
+#define CCACHE_EVICTIONS(cache) (cache->_evictions)
+
+// Macro API functions.
+#define CCACHE_INIT(cache, key_type, max_entries, max_charge, hash_func, cmp_func, kdtor, vdtor)   \
+    (ccache_init(                                                                                  \
+        &cache, sizeof(key_type), max_entries, max_charge, hash_func, cmp_func, kdtor, vdtor       \
+    ))
+#define CCACHE_INIT_WITH(                                                                          \
+    cache, key_type, max_entries, max_charge, hash_func, cmp_func, kdtor, vdtor, allocator         \
+)                                                                                                  \
+    (ccache_init_with(                                                                             \
+        &cache, sizeof(key_type), max_entries, max_charge, hash_func, cmp_func, kdtor, vdtor,      \
+        allocator                                                                                  \
+    ))
+#define CCACHE_UNINIT(cache) (ccache_uninit(&cache))
+#define CCACHE_GETVAL(cache, key, out) (ccache_get(&cache, (const void *)key, (void **)&out))
+#define CCACHE_PUT(cache, key, value, charge)                                                      \
+    (ccache_put(&cache, (void *)key, (void *)value, charge))
+#define CCACHE_REMOVE(cache, key) (ccache_remove(&cache, (const void *)key))
+#define CCACHE_EVICT(cache) (ccache_evict(&cache))
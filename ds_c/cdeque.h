@@ -0,0 +1,272 @@
+/*  cdeque.h
+ *  A double-ended queue in C, as a power-of-two ring buffer growing like cvec.h.
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+#include "cvec.h"
+
+/*
+    Deque header data. Mirrors cvec_t, with the ring's start. Element i lives in slot
+    `(head + i) & (capacity - 1)`, so pushes and pops at either end never move other elements.
+*/
+typedef struct {
+    char *_buffer;
+    size_t _element_size;
+    size_t _capacity; // Power of two.
+    size_t _size;
+    size_t _head; // Slot of the front element.
+    void (*_destructor)(void *);
+    const callocator_t *_allocator; // NULL for malloc().
+} cdeque_t;
+
+// Returns the address of a slot.
+_CVSTCINL void *_cdeque_slot(const cdeque_t *cdeque, size_t slot) {
+    return cdeque->_buffer + (slot & (cdeque->_capacity - 1)) * cdeque->_element_size;
+}
+
+// Copies `count` elements into a ring of `capacity` slots from a given slot, wrapping at most once.
+_CVSTCINL void _cdeque_write(
+    char *buffer, size_t capacity, size_t esize, size_t slot, const void *elements, size_t count
+) {
+    slot &= capacity - 1;
+    const size_t first = count < capacity - slot ? count : capacity - slot;
+    memcpy(buffer + slot * esize, elements, first * esize);
+    memcpy(buffer, (const char *)elements + first * esize, (count - first) * esize);
+}
+
+// Copies `count` elements out of a ring of `capacity` slots from a given slot, wrapping at most
+// once.
+_CVSTCINL void _cdeque_read(
+    const char *buffer, size_t capacity, size_t esize, size_t slot, void *out, size_t count
+) {
+    slot &= capacity - 1;
+    const size_t first = count < capacity - slot ? count : capacity - slot;
+    memcpy(out, buffer + slot * esize, first * esize);
+    memcpy((char *)out + first * esize, buffer, (count - first) * esize);
+}
+
+/*
+    Initializes a given pointer with a deque, allocating through `allocator` (NULL for malloc()).
+    The capacity is rounded up to a power of two.
+*/
+_CVSTCINL _Bool cdeque_init_with(
+    cdeque_t **deque,
+    size_t element_size,
+    size_t initial_capacity,
+    void (*destructor)(void *),
+    const callocator_t *allocator
+) {
+    _CVREQUIRE(deque && element_size, return _CVFALSE);
+    initial_capacity = _cvec_nexp2(initial_capacity);
+    _CVREQUIRE(initial_capacity < SIZE_MAX / element_size, return _CVFALSE);
+    cdeque_t *cdeque = callocator_alloc(allocator, sizeof(cdeque_t), 0);
+    _CVREQUIRE(cdeque, return _CVFALSE);
+    *cdeque = (cdeque_t){._buffer = callocator_alloc(allocator, initial_capacity * element_size, 0),
+                         ._element_size = element_size,
+                         ._capacity = initial_capacity,
+                         ._size = 0,
+                         ._head = 0,
+                         ._destructor = destructor,
+                         ._allocator = allocator};
+    _CVREQUIRE(
+        cdeque->_buffer, callocator_free(allocator, cdeque, sizeof(cdeque_t)); return _CVFALSE
+    );
+    *deque = cdeque;
+    return _CVTRUE;
+}
+
+// Initializes a given pointer with a deque.
+_CVSTCINL _Bool cdeque_init(
+    cdeque_t **deque, size_t element_size, size_t initial_capacity, void (*destructor)(void *)
+) {
+    return cdeque_init_with(deque, element_size, initial_capacity, destructor, NULL);
+}
+
+// Destroys every element, should a destructor be provided. Keeps the capacity.
+_CVSTCINL void cdeque_clear(cdeque_t **deque) {
+    _CVREQUIRE(deque && *deque, return);
+    cdeque_t *cdeque = *deque;
+    if (cdeque->_destructor) {
+        _CVFOR(i, 0, cdeque->_size, 1) {
+            cdeque->_destructor(_cdeque_slot(cdeque, cdeque->_head + i));
+        }
+    }
+    cdeque->_size = 0;
+    cdeque->_head = 0;
+}
+
+// Uninitializes/destroys a deque along with its elements.
+_CVSTCINL void cdeque_uninit(cdeque_t **deque) {
+    _CVREQUIRE(deque && *deque, return);
+    cdeque_t *cdeque = *deque;
+    cdeque_clear(deque);
+    callocator_free(cdeque->_allocator, cdeque->_buffer, cdeque->_capacity * cdeque->_element_size);
+    callocator_free(cdeque->_allocator, cdeque, sizeof(cdeque_t));
+    *deque = NULL;
+}
+
+/*
+    Guarantees the capacity >= specified capacity, rounded up to a power of two. The buffer is
+    reallocated, and the wrapped part of the ring, shorter than the old capacity, is moved into
+    the new space past it.
+*/
+_CVSTCINL _Bool cdeque_reserve(cdeque_t **deque, size_t new_capacity) {
+    _CVREQUIRE(deque && *deque, return _CVFALSE);
+    cdeque_t *cdeque = *deque;
+    _CVREQUIRE(new_capacity > cdeque->_capacity, return _CVTRUE);
+    new_capacity = _cvec_nexp2(new_capacity);
+    _CVREQUIRE(SIZE_MAX / cdeque->_element_size > new_capacity, return _CVFALSE);
+    const size_t esize = cdeque->_element_size;
+    char *buffer = callocator_realloc(
+        cdeque->_allocator, cdeque->_buffer, cdeque->_capacity * esize, new_capacity * esize
+    );
+    _CVREQUIRE(buffer, return _CVFALSE);
+    if (cdeque->_head + cdeque->_size > cdeque->_capacity) {
+        const size_t wrapped = cdeque->_head + cdeque->_size - cdeque->_capacity;
+        memcpy(buffer + cdeque->_capacity * esize, buffer, wrapped * esize);
+    }
+    cdeque->_buffer = buffer;
+    cdeque->_capacity = new_capacity;
+    return _CVTRUE;
+}
+
+// Pushes an element to the back of the deque.
+_CVSTCINL _Bool cdeque_pushback(cdeque_t **deque, const void *element) {
+    _CVREQUIRE(deque && *deque && element, return _CVFALSE);
+    if ((*deque)->_size == (*deque)->_capacity) {
+        _CVREQUIRE(cdeque_reserve(deque, (*deque)->_capacity + 1), return _CVFALSE);
+    }
+    cdeque_t *cdeque = *deque;
+    memcpy(_cdeque_slot(cdeque, cdeque->_head + cdeque->_size), element, cdeque->_element_size);
+    ++cdeque->_size;
+    return _CVTRUE;
+}
+
+// Pushes an element to the front of the deque.
+_CVSTCINL _Bool cdeque_pushfront(cdeque_t **deque, const void *element) {
+    _CVREQUIRE(deque && *deque && element, return _CVFALSE);
+    if ((*deque)->_size == (*deque)->_capacity) {
+        _CVREQUIRE(cdeque_reserve(deque, (*deque)->_capacity + 1), return _CVFALSE);
+    }
+    cdeque_t *cdeque = *deque;
+    cdeque->_head = (cdeque->_head - 1) & (cdeque->_capacity - 1);
+    memcpy(_cdeque_slot(cdeque, cdeque->_head), element, cdeque->_element_size);
+    ++cdeque->_size;
+    return _CVTRUE;
+}
+
+// Pops the back element of the deque, moving it to `out` if non-NULL, else destroying it.
+_CVSTCINL _Bool cdeque_popback(cdeque_t **deque, void *out) {
+    _CVREQUIRE(deque && *deque && (*deque)->_size, return _CVFALSE);
+    cdeque_t *cdeque = *deque;
+    --cdeque->_size;
+    void *slot = _cdeque_slot(cdeque, cdeque->_head + cdeque->_size);
+    if (out) {
+        memcpy(out, slot, cdeque->_element_size);
+    } else if (cdeque->_destructor) {
+        cdeque->_destructor(slot);
+    }
+    return _CVTRUE;
+}
+
+// Pops the front element of the deque, moving it to `out` if non-NULL, else destroying it.
+_CVSTCINL _Bool cdeque_popfront(cdeque_t **deque, void *out) {
+    _CVREQUIRE(deque && *deque && (*deque)->_size, return _CVFALSE);
+    cdeque_t *cdeque = *deque;
+    void *slot = _cdeque_slot(cdeque, cdeque->_head);
+    if (out) {
+        memcpy(out, slot, cdeque->_element_size);
+    } else if (cdeque->_destructor) {
+        cdeque->_destructor(slot);
+    }
+    cdeque->_head = (cdeque->_head + 1) & (cdeque->_capacity - 1);
+    --cdeque->_size;
+    return _CVTRUE;
+}
+
+// Returns the address of the element at an index from the front, or `NULL` if out of range.
+_CVSTCINL void *cdeque_at(cdeque_t **deque, size_t index) {
+    _CVREQUIRE(deque && *deque && index < (*deque)->_size, return NULL);
+    return _cdeque_slot(*deque, (*deque)->_head + index);
+}
+
+// Pushes `count` elements to the back of the deque, with at most two copies.
+_CVSTCINL _Bool cdeque_enqueue(cdeque_t **deque, const void *elements, size_t count) {
+    _CVREQUIRE(deque && *deque && (elements || !count), return _CVFALSE);
+    _CVREQUIRE(count <= SIZE_MAX - (*deque)->_size, return _CVFALSE);
+    _CVREQUIRE(count, return _CVTRUE);
+    _CVREQUIRE(cdeque_reserve(deque, (*deque)->_size + count), return _CVFALSE);
+    cdeque_t *cdeque = *deque;
+    _cdeque_write(
+        cdeque->_buffer, cdeque->_capacity, cdeque->_element_size, cdeque->_head + cdeque->_size,
+        elements, count
+    );
+    cdeque->_size += count;
+    return _CVTRUE;
+}
+
+/*
+    Pops up to `count` elements from the front of the deque, moving them to `out` if non-NULL,
+    else destroying them. Returns the number of elements popped.
+*/
+_CVSTCINL size_t cdeque_dequeue(cdeque_t **deque, void *out, size_t count) {
+    _CVREQUIRE(deque && *deque, return 0);
+    cdeque_t *cdeque = *deque;
+    count = count < cdeque->_size ? count : cdeque->_size;
+    if (out) {
+        _cdeque_read(
+            cdeque->_buffer, cdeque->_capacity, cdeque->_element_size, cdeque->_head, out, count
+        );
+    } else if (cdeque->_destructor) {
+        _CVFOR(i, 0, count, 1) { cdeque->_destructor(_cdeque_slot(cdeque, cdeque->_head + i)); }
+    }
+    cdeque->_head = (cdeque->_head + count) & (cdeque->_capacity - 1);
+    cdeque->_size -= count;
+    return count;
+}
+
+/*
+    Returns the deque's elements, front to back, as at most two contiguous spans: the first
+    through the return value and `out_first`, the second through `out_second` and
+    `out_second_count` (0 unless the ring wraps). Lets consumers process elements in place,
+    then drop them with cdeque_dequeue(deque, NULL, n).
+*/
+_CVSTCINL size_t cdeque_spans(
+    cdeque_t **deque, void **out_first, void **out_second, size_t *out_second_count
+) {
+    _CVREQUIRE(deque && *deque && out_first && out_second && out_second_count, return 0);
+    const cdeque_t *cdeque = *deque;
+    const size_t first = cdeque->_size < cdeque->_capacity - cdeque->_head
+                             ? cdeque->_size
+                             : cdeque->_capacity - cdeque->_head;
+    *out_first = _cdeque_slot(cdeque, cdeque->_head);
+    *out_second = cdeque->_buffer;
+    *out_second_count = cdeque->_size - first;
+    return first;
+}
+
+// Macro API accessors.
+#define CDEQUE_SIZE(deque) (deque->_size)
+#define CDEQUE_CAPACITY(deque) (deque->_capacity)
+#define CDEQUE_ESIZE(deque) (deque->_element_size)
+
+// Macro API functions.
+#define CDEQUE_INIT(deque, type, init_capacity, destructor)                                        \
+    (cdeque_init(&deque, sizeof(type), init_capacity, destructor))
+#define CDEQUE_INIT_WITH(deque, type, init_capacity, destructor, allocator)                        \
+    (cdeque_init_with(&deque, sizeof(type), init_capacity, destructor, allocator))
+#define CDEQUE_UNINIT(deque) (cdeque_uninit(&deque))
+#define CDEQUE_CLEAR(deque) (cdeque_clear(&deque))
+#define CDEQUE_RESERVE(deque, capacity) (cdeque_reserve(&deque, capacity))
+#define CDEQUE_PUSHBACK(deque, type, element)                                                      \
+    (cdeque_pushback(&deque, (const void *)&(type){element}))
+#define CDEQUE_PUSHFRONT(deque, type, element)                                                     \
+    (cdeque_pushfront(&deque, (const void *)&(type){element}))
+#define CDEQUE_POPBACK(deque, out) (cdeque_popback(&deque, out))
+#define CDEQUE_POPFRONT(deque, out) (cdeque_popfront(&deque, out))
+#define CDEQUE_AT(deque, type, index) ((type *)cdeque_at(&deque, index))
+#define CDEQUE_ENQUEUE(deque, elements, count)                                                     \
+    (cdeque_enqueue(&deque, (const void *)(elements), count))
+#define CDEQUE_DEQUEUE(deque, out, count) (cdeque_dequeue(&deque, out, count))
@@ -0,0 +1,160 @@
+/*  cdeque_spsc.h
+ *  A bounded, lock-free single-producer/single-consumer ring queue built on top of cdeque.h.
+ *  Requires C11 atomics (__STDC_NO_ATOMICS__ undefined).
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+#include "cdeque.h"
+
+#include <stdatomic.h>
+
+#define _CDQS_LINE 64 // Keeps each side's index on its own cache line.
+
+/*
+    The producer owns `_tail` and the consumer `_head`. Both only grow, and their difference is the
+    queue's size. Each side caches the other's index and reloads it only when the queue looks
+    full (or empty), so the shared cache lines are rarely touched.
+    Exactly one thread may push and one thread may pop at a time. Capacity is fixed, since the
+    ring cannot move under the other side.
+*/
+typedef struct {
+    _Alignas(_CDQS_LINE) _Atomic size_t _tail; // Next slot to write.
+    size_t _cached_head;                       // Producer's last view of `_head`.
+    _Alignas(_CDQS_LINE) _Atomic size_t _head; // Next slot to read.
+    size_t _cached_tail;                       // Consumer's last view of `_tail`.
+    _Alignas(_CDQS_LINE) char *_buffer;
+    size_t _element_size;
+    size_t _capacity; // Power of two.
+    void (*_destructor)(void *);
+    const callocator_t *_allocator; // NULL for malloc().
+} cdeque_spsc_t;
+
+/*
+    Initializes a given pointer with a queue of `capacity` elements, rounded up to a power of two,
+    allocating through `allocator` (NULL for malloc()). Not thread-safe: publish the queue to both
+    threads afterwards.
+*/
+_CVSTCINL _Bool cdeque_spsc_init_with(
+    cdeque_spsc_t **queue,
+    size_t element_size,
+    size_t capacity,
+    void (*destructor)(void *),
+    const callocator_t *allocator
+) {
+    _CVREQUIRE(queue && element_size, return _CVFALSE);
+    capacity = _cvec_nexp2(capacity);
+    _CVREQUIRE(capacity < SIZE_MAX / element_size, return _CVFALSE);
+    cdeque_spsc_t *spsc = callocator_alloc(allocator, sizeof(cdeque_spsc_t), _CDQS_LINE);
+    _CVREQUIRE(spsc, return _CVFALSE);
+    spsc->_buffer = callocator_alloc(allocator, capacity * element_size, _CDQS_LINE);
+    _CVREQUIRE(
+        spsc->_buffer, callocator_free(allocator, spsc, sizeof(cdeque_spsc_t)); return _CVFALSE
+    );
+    atomic_init(&spsc->_tail, 0);
+    atomic_init(&spsc->_head, 0);
+    spsc->_cached_head = 0;
+    spsc->_cached_tail = 0;
+    spsc->_element_size = element_size;
+    spsc->_capacity = capacity;
+    spsc->_destructor = destructor;
+    spsc->_allocator = allocator;
+    *queue = spsc;
+    return _CVTRUE;
+}
+
+// Initializes a given pointer with a queue of `capacity` elements.
+_CVSTCINL _Bool cdeque_spsc_init(
+    cdeque_spsc_t **queue, size_t element_size, size_t capacity, void (*destructor)(void *)
+) {
+    return cdeque_spsc_init_with(queue, element_size, capacity, destructor, NULL);
+}
+
+// Uninitializes/destroys a queue along with the elements still in it. Both threads must be done.
+_CVSTCINL void cdeque_spsc_uninit(cdeque_spsc_t **queue) {
+    _CVREQUIRE(queue && *queue, return);
+    cdeque_spsc_t *spsc = *queue;
+    const size_t tail = atomic_load_explicit(&spsc->_tail, memory_order_acquire);
+    if (spsc->_destructor) {
+        for (size_t i = atomic_load_explicit(&spsc->_head, memory_order_relaxed); i != tail; ++i) {
+            spsc->_destructor(spsc->_buffer + (i & (spsc->_capacity - 1)) * spsc->_element_size);
+        }
+    }
+    callocator_free(spsc->_allocator, spsc->_buffer, spsc->_capacity * spsc->_element_size);
+    callocator_free(spsc->_allocator, spsc, sizeof(cdeque_spsc_t));
+    *queue = NULL;
+}
+
+/*
+    Producer only. Pushes up to `count` elements with at most two copies, and publishes them at
+    once. Returns the number pushed, short of `count` when the queue fills up.
+*/
+_CVSTCINL size_t cdeque_spsc_enqueue(cdeque_spsc_t **queue, const void *elements, size_t count) {
+    _CVREQUIRE(queue && *queue && elements, return 0);
+    cdeque_spsc_t *spsc = *queue;
+    const size_t tail = atomic_load_explicit(&spsc->_tail, memory_order_relaxed);
+    if (spsc->_capacity - (tail - spsc->_cached_head) < count) {
+        spsc->_cached_head = atomic_load_explicit(&spsc->_head, memory_order_acquire);
+    }
+    const size_t free_slots = spsc->_capacity - (tail - spsc->_cached_head);
+    count = count < free_slots ? count : free_slots;
+    _CVREQUIRE(count, return 0);
+    _cdeque_write(spsc->_buffer, spsc->_capacity, spsc->_element_size, tail, elements, count);
+    atomic_store_explicit(&spsc->_tail, tail + count, memory_order_release);
+    return count;
+}
+
+/*
+    Consumer only. Pops up to `count` elements into `out` with at most two copies, and releases
+    their slots at once. Returns the number popped, short of `count` when the queue runs empty.
+*/
+_CVSTCINL size_t cdeque_spsc_dequeue(cdeque_spsc_t **queue, void *out, size_t count) {
+    _CVREQUIRE(queue && *queue && out, return 0);
+    cdeque_spsc_t *spsc = *queue;
+    const size_t head = atomic_load_explicit(&spsc->_head, memory_order_relaxed);
+    if (spsc->_cached_tail - head < count) {
+        spsc->_cached_tail = atomic_load_explicit(&spsc->_tail, memory_order_acquire);
+    }
+    const size_t available = spsc->_cached_tail - head;
+    count = count < available ? count : available;
+    _CVREQUIRE(count, return 0);
+    _cdeque_read(spsc->_buffer, spsc->_capacity, spsc->_element_size, head, out, count);
+    atomic_store_explicit(&spsc->_head, head + count, memory_order_release);
+    return count;
+}
+
+// Producer only. Pushes an element, or returns `false` if the queue is full.
+_CVSTCINL _Bool cdeque_spsc_push(cdeque_spsc_t **queue, const void *element) {
+    return cdeque_spsc_enqueue(queue, element, 1) == 1;
+}
+
+// Consumer only. Pops an element into `out`, or returns `false` if the queue is empty.
+_CVSTCINL _Bool cdeque_spsc_pop(cdeque_spsc_t **queue, void *out) {
+    return cdeque_spsc_dequeue(queue, out, 1) == 1;
+}
+
+// Returns a snapshot of the queue's size, exact only from a thread that neither pushes nor pops.
+_CVSTCINL size_t cdeque_spsc_size(cdeque_spsc_t **queue) {
+    _CVREQUIRE(queue && *queue, return 0);
+    const size_t head = atomic_load_explicit(&(*queue)->_head, memory_order_acquire);
+    return atomic_load_explicit(&(*queue)->_tail, memory_order_acquire) - head;
+}
+
+// Macro API accessors.
+#define CDEQUE_SPSC_CAPACITY(queue) (queue->_capacity)
+#define CDEQUE_SPSC_ESIZE(queue) (queue->_element_size)
+
+// Macro API functions.
+#define CDEQUE_SPSC_INIT(queue, type, capacity, destructor)                                        \
+    (cdeque_spsc_init(&queue, sizeof(type), capacity, destructor))
+#define CDEQUE_SPSC_INIT_WITH(queue, type, capacity, destructor, allocator)                        \
+    (cdeque_spsc_init_with(&queue, sizeof(type), capacity, destructor, allocator))
+#define CDEQUE_SPSC_UNINIT(queue) (cdeque_spsc_uninit(&queue))
+#define CDEQUE_SPSC_SIZE(queue) (cdeque_spsc_size(&queue))
+#define CDEQUE_SPSC_PUSH(queue, type, element)                                                     \
+    (cdeque_spsc_push(&queue, (const void *)&(type){element}))
+#define CDEQUE_SPSC_POP(queue, out) (cdeque_spsc_pop(&queue, out))
+#define CDEQUE_SPSC_ENQUEUE(queue, elements, count)                                                \
+    (cdeque_spsc_enqueue(&queue, (const void *)(elements), count))
+#define CDEQUE_SPSC_DEQUEUE(queue, out, count) (cdeque_spsc_dequeue(&queue, out, count))
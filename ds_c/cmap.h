@@ -7,9 +7,31 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "cpool.h"
+
+// Defining CMAP_ENABLE_STATS (consistently across translation units) makes every map keep runtime
+// counters for cmap_stats(). Otherwise, the counting code compiles away entirely.
+#if defined(CMAP_ENABLE_STATS)
+#include <stdatomic.h>
+#include <time.h>
+#define _CMSTATS(...) __VA_ARGS__
+#define _CMSTAT_ADD(map, counter, n)                                                               \
+    (atomic_fetch_add_explicit(&(map)->_counters.counter, n, memory_order_relaxed))
+#else
+#define _CMSTATS(...)
+#define _CMSTAT_ADD(map, counter, n) ((void)0)
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define _CMSTCINL static inline
 #define _CMREQUIRE(condition, action)                                                              \
     do {                                                                                           \
@@ -23,13 +45,43 @@
 #define _CMFOR(iter, start, end, step) for (size_t iter = (start); iter < (end); iter += (step))
 #define _CMSTRITER(iter, str) for (const char *iter = str; *(iter); ++iter)
 #define _CMMAX(a, b) ((a) > (b) ? (a) : (b))
+#define _CMMIN(a, b) ((a) < (b) ? (a) : (b))
+#if defined(__GNUC__) || defined(__clang__)
+#define _CMPREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(__SSE2__)
+#define _CMPREFETCH(addr) _mm_prefetch((const char *)(addr), _MM_HINT_T0)
+#else
+#define _CMPREFETCH(addr) ((void)(addr))
+#endif
 #define _CM_INLINE_SIZE 3
 #define _CMLFACTOR_LIMIT 0.7
 #define _CMLFACTOR_MIN 0.2
+#define _CM_MIGRATE_STEP 8 // Buckets migrated per operation during an incremental resize.
+#define _CM_BATCH_SIZE 64  // Keys hashed and prefetched ahead of resolution by the batch API.
 
 #define _CMSENTINEL 0xC0FFEEC0FFEECAFE
 #define _CM_MAX_ENTRIES UINT16_MAX
 
+// Swiss engine control bytes. Full slots store the low 7 bits of the hash (high bit clear).
+#define _CM_CTRL_EMPTY ((uint8_t)0x80)
+#define _CM_CTRL_DELETED ((uint8_t)0xFE)
+#define _CMSWISS_LFACTOR_LIMIT 0.875
+#define _CMCOMPACT_LFACTOR_LIMIT (2.0 / 3.0) // Linear probing degrades sooner than group probing.
+
+// Compact engine index slots. Non-negative slots are positions in the dense entry array.
+#define _CM_INDEX_EMPTY ((ptrdiff_t)-1)
+#define _CM_INDEX_DUMMY ((ptrdiff_t)-2) // The entry was removed. Still diverts probes.
+#if defined(__AVX2__)
+#define _CM_GROUP_WIDTH 32
+#else
+#define _CM_GROUP_WIDTH 16
+#endif
+
+// Negative-lookup filter of CMAP_FLAG_FILTER: a split-block Bloom filter of 32-byte blocks.
+#define _CM_FILTER_WORDS 8  // 32-bit words per block. Each key sets one bit in every word.
+#define _CM_FILTER_BITS 12  // Filter bits per entry at the maximum load factor.
+#define _CM_FILTER_ALIGN 64 // Blocks never straddle a cache line.
+
 typedef struct {
     void *key;   // Not guaranteed to be a pointer.
     void *value; // Not guaranteed to be a pointer.
@@ -43,24 +95,140 @@ typedef struct {
     _Bool _occupied;
 } cmap_bucket_t;
 
+// Storage engine backing a cmap_t instance.
+typedef enum {
+    CMAP_ENGINE_BUCKET = 0, // Hashed buckets with inline and overflow entries (default).
+    CMAP_ENGINE_SWISS,      // Flat open-addressed slots probed in groups through control bytes.
+    CMAP_ENGINE_COMPACT,    // Narrow index into dense, insertion-ordered entries and their hashes.
+} cmap_engine_t;
+
+// Behavior flags for cmap_options_t.
+#define CMAP_FLAG_INCREMENTAL_RESIZE 0x1u // Spread rehashing over inserts/removes (bucket engine).
+#define CMAP_FLAG_CACHED_HASH 0x2u        // Store each entry's hash to skip rehashing and compares.
+#define CMAP_FLAG_FILTER 0x4u             // Answer most misses from a Bloom filter, before probing.
+
+#define CMAP_STATS_BINS 16 // Histogram bins. The last bin also counts everything beyond it.
+
+// Output formats of cmap_stats_dump().
+typedef enum {
+    CMAP_STATS_TEXT = 0,
+    CMAP_STATS_JSON,
+} cmap_stats_format_t;
+
+/*
+    A snapshot of a map's shape and, with CMAP_ENABLE_STATS, of its runtime counters.
+    A probe is one examined entry for CMAP_ENGINE_BUCKET, one probed group for CMAP_ENGINE_SWISS
+    and one examined index slot for CMAP_ENGINE_COMPACT. Occupancy counts buckets (or swiss
+    groups) by their number of entries, and for CMAP_ENGINE_COMPACT, runs of used index slots by
+    their length.
+*/
+typedef struct {
+    cmap_engine_t engine;
+    size_t size;
+    size_t capacity;
+    size_t occupancy[CMAP_STATS_BINS];
+    size_t overflow_arrays;  // CMAP_ENGINE_BUCKET only.
+    size_t overflow_slots;   // CMAP_ENGINE_BUCKET only. Capacity of every overflow array.
+    size_t overflow_entries; // CMAP_ENGINE_BUCKET only.
+    size_t tombstones;       // Deleted swiss slots, or removed compact entries not yet purged.
+    size_t filter_bytes;     // CMAP_FLAG_FILTER only.
+    _Bool counters_enabled;  // Whether the fields below were recorded. Zeroed otherwise.
+    size_t hit_probes[CMAP_STATS_BINS];
+    size_t miss_probes[CMAP_STATS_BINS];
+    size_t comparisons;
+    size_t filtered; // Lookups answered as misses by the CMAP_FLAG_FILTER filter alone.
+    size_t resizes;
+    uint64_t resize_ns;
+} cmap_stats_t;
+
+#if defined(CMAP_ENABLE_STATS)
+// Runtime counters. Atomic, since concurrent readers of a map (e.g. cmap_concurrent_t) record.
+typedef struct {
+    _Atomic size_t hit_probes[CMAP_STATS_BINS];
+    _Atomic size_t miss_probes[CMAP_STATS_BINS];
+    _Atomic size_t comparisons;
+    _Atomic size_t filtered;
+    _Atomic size_t resizes;
+    _Atomic uint64_t resize_ns;
+} _cmap_counters_t;
+#endif
+
+// When a map gives memory back after removals.
+typedef enum {
+    CMAP_SHRINK_EAGER = 0, // Halve the table once the load drops below `min_load` (default).
+    CMAP_SHRINK_LAZY,      // Never on removal. Rehashes that happen anyway size to the entries.
+    CMAP_SHRINK_NEVER,     // Only through cmap_shrink_to_fit().
+} cmap_shrink_t;
+
+// Optional parameters for cmap_init_ex(). A zero-initialized instance selects the defaults.
+typedef struct {
+    cmap_engine_t engine;
+    uint32_t flags;
+    float max_load; // Grow beyond this load factor. 0 selects the engine's default.
+    float min_load; // CMAP_SHRINK_EAGER only. Must stay below `max_load / 2`. 0 for a default.
+    cmap_shrink_t shrink;
+    const callocator_t *allocator; // Allocates the map and all of its storage. NULL for malloc().
+} cmap_options_t;
+
 typedef struct {
-    cmap_bucket_t *_buckets;
+    cmap_bucket_t *_buckets;     // CMAP_ENGINE_BUCKET only.
+    cmap_bucket_t *_old_buckets; // Buckets still being migrated by an incremental resize.
+    size_t _old_capacity;
+    size_t _migrate_idx;    // Buckets of `_old_buckets` below this index are already migrated.
+    size_t _bucket_size;    // Bucket stride, including the inline hashes of CMAP_FLAG_CACHED_HASH.
+    cpool_t *_pool;         // CMAP_ENGINE_BUCKET only. Overflow arrays of `_buckets`.
+    cpool_t *_old_pool;     // Overflow arrays of `_old_buckets`.
+    uint8_t *_ctrl;         // CMAP_ENGINE_SWISS only. One control byte per slot.
+    cmap_entry_t *_slots;   // CMAP_ENGINE_SWISS only. Shares its allocation with `_ctrl`.
+    size_t *_hashes;        // CMAP_ENGINE_SWISS with CMAP_FLAG_CACHED_HASH, or CMAP_ENGINE_COMPACT.
+    size_t _tombstones;     // CMAP_ENGINE_SWISS only. Slots marked as deleted.
+    cmap_entry_t *_entries; // CMAP_ENGINE_COMPACT only. Dense, in insertion order.
+    void *_index;           // CMAP_ENGINE_COMPACT only. Shares its allocation with `_entries`.
+    uint8_t _index_width;   // Bytes per index slot: 1, 2, 4 or 8.
+    size_t _used;           // Entries appended to `_entries`, including removed ones.
+    uint32_t *_filter;      // CMAP_FLAG_FILTER only. Holds the hash of every key.
+    size_t _filter_blocks;  // A power of two.
+    size_t _filter_stale;   // Removed keys whose bits are still set.
     size_t _size;
-    size_t _capacity;
+    size_t _capacity; // Buckets for CMAP_ENGINE_BUCKET, slots for the others (index slots).
+    cmap_engine_t _engine;
+    uint32_t _flags;
+    float _max_load;
+    float _min_load;
+    cmap_shrink_t _shrink;
+    size_t _reserved; // Entries guaranteed to fit without a rehash, set by cmap_reserve().
+    const callocator_t *_allocator;
     uint8_t _key_size; // Limited to sizeof(void*). Otherwise, store indirectly through a pointer.
     uint8_t _val_size; // Limited to sizeof(void*). Otherwise, store indirectly through a pointer.
     size_t (*_hash_func)(const void *);
     int (*_comparison_func)(const void *, const void *); // Receives the element to be compared.
     void (*_key_destructor)(void **); // Receives a pointer to the element to be destroyed.
     void (*_val_destructor)(void **); // Receives a pointer to the element to be destroyed.
+    _CMSTATS(_cmap_counters_t _counters;)
 } cmap_t;
 
+// Buckets are laid out with a per-map stride. With CMAP_FLAG_CACHED_HASH, the hashes of the inline
+// entries follow each bucket, and the hashes of the overflow entries follow the overflow array.
+#define _CMBUCKET(map, buckets, idx)                                                               \
+    ((cmap_bucket_t *)((char *)(buckets) + (idx) * (map)->_bucket_size))
+#define _CMINLINE_HASHES(bucket) ((size_t *)((bucket) + 1))
+#define _CMOVERFLOW_HASHES(bucket)                                                                 \
+    ((size_t *)((bucket)->_overflow_entries + (bucket)->_overflow_capacity))
+
 typedef struct {
     cmap_t *map;
-    size_t bucket_idx;
+    size_t bucket_idx; // Slot index for CMAP_ENGINE_SWISS, entry index for CMAP_ENGINE_COMPACT.
     size_t st_idx;
 } cmap_iterator_t;
 
+// Length-aware string key. Use with cmap_strkey_hash() and cmap_strkey_cmp(), storing pointers to
+// keys that outlive their entries.
+typedef struct {
+    const char *ptr; // Not required to be NUL-terminated.
+    size_t len;
+    size_t hash;
+} cmap_strkey_t;
+
 _CMSTCINL size_t _cmap_nexp2(size_t n) {
     _CMREQUIRE(n, return 1);
     if (n > SIZE_MAX / 2) {
@@ -79,6 +247,28 @@ _CMSTCINL size_t _cmap_nexp2(size_t n) {
     return n;
 }
 
+#if defined(CMAP_ENABLE_STATS)
+// Records the probe length of a lookup.
+_CMSTCINL void _cmap_stats_probe(cmap_t *cmap, size_t probes, _Bool hit) {
+    _Atomic size_t *bins = hit ? cmap->_counters.hit_probes : cmap->_counters.miss_probes;
+    atomic_fetch_add_explicit(&bins[_CMMIN(probes, CMAP_STATS_BINS - 1)], 1, memory_order_relaxed);
+}
+
+_CMSTCINL uint64_t _cmap_stats_clock(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Records a completed resize that started at `start`.
+_CMSTCINL void _cmap_stats_resized(cmap_t *cmap, uint64_t start, _Bool ok) {
+    if (ok) {
+        _CMSTAT_ADD(cmap, resizes, 1);
+        _CMSTAT_ADD(cmap, resize_ns, _cmap_stats_clock() - start);
+    }
+}
+#endif
+
 /*
     Generic hash function for integer-types (char, int, long, ...).
     Uses XXH64_avalanche() and XXH32_avalanche() from xxHash.
@@ -103,29 +293,110 @@ _CMSTCINL size_t cmap_genhash(const void *in_key) {
     return key;
 }
 
+// Unaligned native-endian loads used by the string hash.
+_CMSTCINL uint64_t _cmap_read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+_CMSTCINL uint64_t _cmap_read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Folds one 64-bit word into an accumulator. Same round as XXH64_round() from xxHash.
+_CMSTCINL uint64_t _cmap_hash_round(uint64_t acc, uint64_t input) {
+    acc += input * 0xC2B2AE3D27D4EB4FULL; // XXH_PRIME64_2 (xxhash.h)
+    acc = (acc << 31) | (acc >> 33);
+    return acc * 0x9E3779B185EBCA87ULL; // XXH_PRIME64_1 (xxhash.h)
+}
+
 /*
-    Generic hash function for strings (const char*),
-    but this does not work on wide-strings (const wchar*).
-    Uses the FNV-1a hash function.
+    Hash function for byte strings of a known length, consuming 16 bytes per step through two
+    independent accumulators. The last 1-16 bytes are read with (possibly overlapping) full-width
+    loads instead of a byte loop, so no byte outside of `[data, data + len)` is ever read.
 */
-_CMSTCINL size_t cmap_strhash(const void *in_key) {
-    const char *key = (const char *)in_key;
-#if SIZE_MAX == UINT64_MAX
-    size_t hash = 0xCBF29CE484222325; // FNV offset-basis (64-bits)
-    _CMSTRITER(c, key) {
-        hash ^= (size_t)*c;
-        hash *= 0x00000100000001B3; // FNV prime (64-bits)
+_CMSTCINL size_t cmap_strnhash(const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t acc1 = 0x27D4EB2F165667C5ULL + len; // XXH_PRIME64_5 (xxhash.h)
+    uint64_t acc2 = 0x85EBCA77C2B2AE63ULL ^ len; // XXH_PRIME64_4 (xxhash.h)
+    uint64_t tail1 = 0;
+    uint64_t tail2 = 0;
+    if (len >= 16) {
+        const uint8_t *last = p + len - 16;
+        for (; p < last; p += 16) {
+            acc1 = _cmap_hash_round(acc1, _cmap_read64(p));
+            acc2 = _cmap_hash_round(acc2, _cmap_read64(p + 8));
+        }
+        tail1 = _cmap_read64(last);
+        tail2 = _cmap_read64(last + 8);
+    } else if (len >= 8) {
+        tail1 = _cmap_read64(p);
+        tail2 = _cmap_read64(p + len - 8);
+    } else if (len >= 4) {
+        tail1 = _cmap_read32(p);
+        tail2 = _cmap_read32(p + len - 4);
+    } else if (len > 0) {
+        tail1 = (uint64_t)p[0] | (uint64_t)p[len / 2] << 8 | (uint64_t)p[len - 1] << 16;
     }
+    acc1 = _cmap_hash_round(acc1, tail1);
+    acc2 = _cmap_hash_round(acc2, tail2);
+    uint64_t hash = ((acc1 << 1) | (acc1 >> 63)) + ((acc2 << 7) | (acc2 >> 57));
+    hash ^= hash >> 33;
+    hash *= 0xC2B2AE3D27D4EB4FULL; // XXH_PRIME64_2 (xxhash.h)
+    hash ^= hash >> 29;
+    hash *= 0x165667B19E3779F9ULL; // XXH_PRIME64_3 (xxhash.h)
+    hash ^= hash >> 32;
+#if SIZE_MAX == UINT64_MAX
+    return hash;
 #elif SIZE_MAX == UINT32_MAX
-    size_t hash = 0x811C9DC5; // FNV offset-basis (32-bits)
-    _CMSTRITER(c, key) {
-        hash ^= (size_t)c;
-        hash *= 0x01000193; // FNV prime (32-bits)
-    }
+    return (size_t)(hash ^ (hash >> 32));
 #else
 #error "UNKNOWN ARCHITECTURE (Only 64-bit/32-bit supported)."
 #endif
-    return hash;
+}
+
+/*
+    Generic hash function for strings (const char*),
+    but this does not work on wide-strings (const wchar*).
+    Uses cmap_strnhash() over the length found by strlen().
+*/
+_CMSTCINL size_t cmap_strhash(const void *in_key) {
+    return cmap_strnhash(in_key, strlen((const char *)in_key));
+}
+
+#if SIZE_MAX == UINT64_MAX && defined(__AVX2__)
+// Multiplies each 64-bit lane by a constant. AVX2 lacks a 64-bit multiply, so it is composed of
+// three 32x32 multiplications.
+_CMSTCINL __m256i _cmap_mm256_mullo64(__m256i a, uint64_t c) {
+    const __m256i c_lo = _mm256_set1_epi64x((long long)(c & 0xFFFFFFFF));
+    const __m256i c_hi = _mm256_set1_epi64x((long long)(c >> 32));
+    const __m256i cross = _mm256_add_epi64(
+        _mm256_mul_epu32(_mm256_srli_epi64(a, 32), c_lo), _mm256_mul_epu32(a, c_hi)
+    );
+    return _mm256_add_epi64(_mm256_mul_epu32(a, c_lo), _mm256_slli_epi64(cross, 32));
+}
+#endif
+
+// Batched cmap_genhash(). Hashes four keys per step when AVX2 is available.
+_CMSTCINL void cmap_genhash_batch(void *const *keys, size_t n, size_t *out_hashes) {
+    size_t i = 0;
+#if SIZE_MAX == UINT64_MAX && defined(__AVX2__)
+    for (; i + 4 <= n; i += 4) {
+        __m256i key = _mm256_loadu_si256((const __m256i *)(keys + i));
+        key = _mm256_xor_si256(key, _mm256_srli_epi64(key, 33));
+        key = _cmap_mm256_mullo64(key, 0xC2B2AE3D27D4EB4FULL); // XXH_PRIME64_2 (xxhash.h)
+        key = _mm256_xor_si256(key, _mm256_srli_epi64(key, 29));
+        key = _cmap_mm256_mullo64(key, 0x165667B19E3779F9ULL); // XXH_PRIME64_3 (xxhash.h)
+        key = _mm256_xor_si256(key, _mm256_srli_epi64(key, 32));
+        _mm256_storeu_si256((__m256i *)(out_hashes + i), key);
+    }
+#endif
+    for (; i < n; ++i) {
+        out_hashes[i] = cmap_genhash(keys[i]);
+    }
 }
 
 // Generic wrapper around strcmp.
@@ -133,14 +404,330 @@ _CMSTCINL int cmap_strcmp(const void *a, const void *b) {
     return strcmp((const char *)a, (const char *)b);
 }
 
+/*
+    Measures how evenly a hash function spreads `n` keys over `nbuckets` buckets (rounded up to a
+    power of two, as the buckets are indexed by the low bits of a hash). Writes the number of
+    colliding key pairs relative to the number expected from a uniform hash, so ~1.0 is ideal.
+    Meant to vet a hash function against representative keys before switching to it.
+*/
+_CMSTCINL _Bool cmap_hash_quality(
+    size_t (*hash_func)(const void *), void *const *keys, size_t n, size_t nbuckets,
+    double *out_ratio
+) {
+    _CMREQUIRE(hash_func && keys && out_ratio && n > 1 && nbuckets, return _CMFALSE);
+    nbuckets = _cmap_nexp2(nbuckets);
+    size_t *counts = calloc(nbuckets, sizeof(size_t));
+    _CMREQUIRE(counts, return _CMFALSE);
+    double collisions = 0;
+    _CMFOR(i, 0, n, 1) {
+        collisions += (double)counts[hash_func(keys[i]) & (nbuckets - 1)]++;
+    }
+    free(counts);
+    *out_ratio = collisions / ((double)n * (double)(n - 1) / 2.0 / (double)nbuckets);
+    return _CMTRUE;
+}
+
+// Builds a length-aware string key, hashing it once up front.
+_CMSTCINL cmap_strkey_t cmap_strkey(const char *ptr, size_t len) {
+    return (cmap_strkey_t){.ptr = ptr, .len = len, .hash = cmap_strnhash(ptr, len)};
+}
+
+// Hash function for `cmap_strkey_t *` keys. Returns the precomputed hash.
+_CMSTCINL size_t cmap_strkey_hash(const void *key) { return ((const cmap_strkey_t *)key)->hash; }
+
+// Comparison function for `cmap_strkey_t *` keys. Rejects on length and hash before the bytes.
+_CMSTCINL int cmap_strkey_cmp(const void *a, const void *b) {
+    const cmap_strkey_t *ka = (const cmap_strkey_t *)a;
+    const cmap_strkey_t *kb = (const cmap_strkey_t *)b;
+    if (ka->len != kb->len || ka->hash != kb->hash) {
+        return 1;
+    }
+    return ka == kb || ka->ptr == kb->ptr ? 0 : memcmp(ka->ptr, kb->ptr, ka->len);
+}
+
 // Generic integer comparison function.
 _CMSTCINL int cmap_gencmp(const void *a, const void *b) { return (a > b) - (a < b); }
 
 // Generic destructor function.
 _CMSTCINL void cmap_gendtor(void **addr) { free(*addr); }
 
-// Initializes a given pointer with a cmap_t instance.
-_CMSTCINL _Bool cmap_init(
+// Counts trailing zero bits of a non-zero mask.
+_CMSTCINL unsigned _cmap_ctz32(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctz(mask);
+#else
+    unsigned n = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+// Returns a bitmask of the slots in a control-byte group that are equal to `tag`.
+_CMSTCINL uint32_t _cmap_group_match(const uint8_t *ctrl, uint8_t tag) {
+#if defined(__AVX2__)
+    const __m256i group = _mm256_loadu_si256((const __m256i *)ctrl);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8((char)tag)));
+#elif defined(__SSE2__)
+    const __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#else
+    uint32_t mask = 0;
+    _CMFOR(i, 0, _CM_GROUP_WIDTH, 1) { mask |= (uint32_t)(ctrl[i] == tag) << i; }
+    return mask;
+#endif
+}
+
+// Returns a bitmask of the slots in a control-byte group that are either empty or deleted.
+_CMSTCINL uint32_t _cmap_group_free(const uint8_t *ctrl) {
+#if defined(__AVX2__)
+    return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)ctrl));
+#elif defined(__SSE2__)
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    uint32_t mask = 0;
+    _CMFOR(i, 0, _CM_GROUP_WIDTH, 1) { mask |= (uint32_t)(ctrl[i] >> 7) << i; }
+    return mask;
+#endif
+}
+
+// Allocates a bucket array with every inline entry marked as empty.
+_CMSTCINL cmap_bucket_t *_cmap_bucket_alloc(cmap_t *cmap, size_t capacity) {
+    cmap_bucket_t *buckets = callocator_calloc(cmap->_allocator, capacity, cmap->_bucket_size);
+    _CMREQUIRE(buckets, return NULL);
+    _CMFOR(i, 0, capacity, 1) {
+        _CMFOR(j, 0, _CM_INLINE_SIZE, 1) {
+            _CMBUCKET(cmap, buckets, i)->_inline_entries[j].key = (void *)_CMSENTINEL;
+        }
+    }
+    return buckets;
+}
+
+// Releases a bucket array of `capacity` buckets, without touching its entries.
+_CMSTCINL void _cmap_bucket_free(cmap_t *cmap, cmap_bucket_t *buckets, size_t capacity) {
+    callocator_free(cmap->_allocator, buckets, capacity * cmap->_bucket_size);
+}
+
+// Returns the j-th entry of a bucket, counting the inline entries first.
+_CMSTCINL cmap_entry_t *_cmap_bucket_entry(cmap_bucket_t *bucket, size_t j) {
+    return j < _CM_INLINE_SIZE ? &bucket->_inline_entries[j]
+                               : &bucket->_overflow_entries[j - _CM_INLINE_SIZE];
+}
+
+// Returns the hash of the j-th entry of a bucket, reading it back when hashes are cached.
+_CMSTCINL size_t _cmap_bucket_hash(cmap_t *cmap, cmap_bucket_t *bucket, size_t j) {
+    if (cmap->_flags & CMAP_FLAG_CACHED_HASH) {
+        return j < _CM_INLINE_SIZE ? _CMINLINE_HASHES(bucket)[j]
+                                   : _CMOVERFLOW_HASHES(bucket)[j - _CM_INLINE_SIZE];
+    }
+    return cmap->_hash_func(_cmap_bucket_entry(bucket, j)->key);
+}
+
+// Returns the bytes per slot of a swiss table.
+_CMSTCINL size_t _cmap_swiss_slot_size(const cmap_t *cmap) {
+    return sizeof(cmap_entry_t) + 1 + (cmap->_flags & CMAP_FLAG_CACHED_HASH ? sizeof(size_t) : 0);
+}
+
+// Allocates the control bytes of a swiss table, followed by its slots (and cached hashes), all
+// marked as empty.
+_CMSTCINL uint8_t *_cmap_swiss_alloc(const cmap_t *cmap, size_t capacity) {
+    const size_t slot_size = _cmap_swiss_slot_size(cmap);
+    _CMREQUIRE(capacity < SIZE_MAX / slot_size, return NULL);
+    uint8_t *ctrl = callocator_alloc(cmap->_allocator, capacity * slot_size, 0);
+    _CMREQUIRE(ctrl, return NULL);
+    memset(ctrl, _CM_CTRL_EMPTY, capacity);
+    return ctrl;
+}
+
+// Points the slot (and cached hash) arrays of a swiss table into its control-byte allocation.
+_CMSTCINL void _cmap_swiss_assign(cmap_t *cmap, uint8_t *ctrl, size_t capacity) {
+    cmap->_ctrl = ctrl;
+    cmap->_slots = (cmap_entry_t *)(ctrl + capacity);
+    cmap->_hashes =
+        cmap->_flags & CMAP_FLAG_CACHED_HASH ? (size_t *)(cmap->_slots + capacity) : NULL;
+    cmap->_capacity = capacity;
+}
+
+// Returns how many entries a compact table of `capacity` index slots can append before a rebuild.
+// Always below `capacity`, so every probe sequence ends at an empty index slot.
+_CMSTCINL size_t _cmap_compact_limit(const cmap_t *cmap, size_t capacity) {
+    const size_t limit = (size_t)(capacity * cmap->_max_load);
+    return _CMMIN(_CMMAX(limit, 1), capacity - 1);
+}
+
+// Returns the narrowest index slot width, in bytes, that can address `limit` entries.
+_CMSTCINL uint8_t _cmap_index_width(size_t limit) {
+    if (limit <= INT8_MAX) {
+        return 1;
+    }
+    if (limit <= INT16_MAX) {
+        return 2;
+    }
+    return limit <= INT32_MAX ? 4 : 8;
+}
+
+// Reads an index slot of a compact table. Sign extension keeps the sentinels equal at every width.
+_CMSTCINL ptrdiff_t _cmap_index_get(const cmap_t *cmap, size_t slot) {
+    switch (cmap->_index_width) {
+    case 1:
+        return ((const int8_t *)cmap->_index)[slot];
+    case 2:
+        return ((const int16_t *)cmap->_index)[slot];
+    case 4:
+        return ((const int32_t *)cmap->_index)[slot];
+    default:
+        return (ptrdiff_t)((const int64_t *)cmap->_index)[slot];
+    }
+}
+
+// Writes an index slot of a compact table.
+_CMSTCINL void _cmap_index_set(cmap_t *cmap, size_t slot, ptrdiff_t value) {
+    switch (cmap->_index_width) {
+    case 1:
+        ((int8_t *)cmap->_index)[slot] = (int8_t)value;
+        break;
+    case 2:
+        ((int16_t *)cmap->_index)[slot] = (int16_t)value;
+        break;
+    case 4:
+        ((int32_t *)cmap->_index)[slot] = (int32_t)value;
+        break;
+    default:
+        ((int64_t *)cmap->_index)[slot] = (int64_t)value;
+        break;
+    }
+}
+
+// Returns the bytes of a compact table's allocation, or 0 if that overflows.
+_CMSTCINL size_t _cmap_compact_bytes(const cmap_t *cmap, size_t capacity) {
+    const size_t limit = _cmap_compact_limit(cmap, capacity);
+    const size_t width = _cmap_index_width(limit);
+    const size_t entry_size = sizeof(cmap_entry_t) + sizeof(size_t);
+    _CMREQUIRE(limit < SIZE_MAX / 2 / entry_size && capacity < SIZE_MAX / 2 / width, return 0);
+    return limit * entry_size + capacity * width;
+}
+
+// Allocates the dense entries of a compact table, followed by their hashes and its index slots,
+// all marked as empty.
+_CMSTCINL cmap_entry_t *_cmap_compact_alloc(const cmap_t *cmap, size_t capacity) {
+    const size_t limit = _cmap_compact_limit(cmap, capacity);
+    const size_t entry_size = sizeof(cmap_entry_t) + sizeof(size_t);
+    const size_t bytes = _cmap_compact_bytes(cmap, capacity);
+    _CMREQUIRE(bytes, return NULL);
+    cmap_entry_t *entries = callocator_alloc(cmap->_allocator, bytes, 0);
+    _CMREQUIRE(entries, return NULL);
+    const size_t index_offset = limit * entry_size;
+    memset((char *)entries + index_offset, 0xFF, bytes - index_offset); // _CM_INDEX_EMPTY.
+    return entries;
+}
+
+// Points the hash and index arrays of a compact table into its entry allocation.
+_CMSTCINL void _cmap_compact_assign(cmap_t *cmap, cmap_entry_t *entries, size_t capacity) {
+    const size_t limit = _cmap_compact_limit(cmap, capacity);
+    cmap->_entries = entries;
+    cmap->_hashes = (size_t *)(entries + limit);
+    cmap->_index = cmap->_hashes + limit;
+    cmap->_index_width = _cmap_index_width(limit);
+    cmap->_capacity = capacity;
+}
+
+// Salts of the filter, one per word of a block (those of the Parquet split-block Bloom filter).
+static const uint32_t _cmap_filter_salts[_CM_FILTER_WORDS] = {
+    0x47B6137BU, 0x44974D91U, 0x8824AD5BU, 0xA2B7289DU,
+    0x705495C7U, 0x2DF1424BU, 0x9EFC4947U, 0x5C6BFB31U,
+};
+
+// Returns the filter block of a hash. The block is picked from remixed high bits, so that it does
+// not follow the bucket (or slot) the low bits select.
+_CMSTCINL uint32_t *_cmap_filter_block(const cmap_t *cmap, size_t hash) {
+    const uint64_t mixed = (uint64_t)hash * 0x9E3779B97F4A7C15ULL;
+    return cmap->_filter + ((size_t)(mixed >> 32) & (cmap->_filter_blocks - 1)) * _CM_FILTER_WORDS;
+}
+
+// Returns the bit a hash sets in a given word of its block.
+_CMSTCINL uint32_t _cmap_filter_bit(size_t hash, size_t word) {
+    return (uint32_t)1 << (((uint32_t)hash * _cmap_filter_salts[word]) >> 27);
+}
+
+_CMSTCINL void _cmap_filter_add(cmap_t *cmap, size_t hash) {
+    uint32_t *block = _cmap_filter_block(cmap, hash);
+    _CMFOR(i, 0, _CM_FILTER_WORDS, 1) { block[i] |= _cmap_filter_bit(hash, i); }
+}
+
+// Returns `false` if a hash was never added to the filter, proving its key absent.
+_CMSTCINL _Bool _cmap_filter_test(const cmap_t *cmap, size_t hash) {
+    const uint32_t *block = _cmap_filter_block(cmap, hash);
+#if defined(__AVX2__)
+    const __m256i salts = _mm256_loadu_si256((const __m256i *)_cmap_filter_salts);
+    const __m256i shifts =
+        _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32((int)(uint32_t)hash), salts), 27);
+    const __m256i bits = _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+    return _mm256_testc_si256(_mm256_load_si256((const __m256i *)block), bits);
+#else
+    // Without a vector multiply, most misses are cheapest to settle on their first clear bit.
+    _CMFOR(i, 0, _CM_FILTER_WORDS, 1) {
+        if (!(block[i] & _cmap_filter_bit(hash, i))) {
+            return _CMFALSE;
+        }
+    }
+    return _CMTRUE;
+#endif
+}
+
+// Sizes the filter for the map's capacity and adds every key back, which also clears the bits of
+// removed keys. If a new filter cannot be allocated, the previous one is refilled instead, so this
+// only fails for a map without one.
+_CMSTCINL _Bool _cmap_filter_rebuild(cmap_t *cmap) {
+    if (!(cmap->_flags & CMAP_FLAG_FILTER)) {
+        return _CMTRUE;
+    }
+    const size_t block_bytes = _CM_FILTER_WORDS * sizeof(uint32_t);
+    const size_t entries = (size_t)(cmap->_capacity * cmap->_max_load) + 1;
+    const size_t blocks = _CMMAX(_cmap_nexp2(entries * _CM_FILTER_BITS / (block_bytes * 8) + 1), 2);
+    if (blocks != cmap->_filter_blocks) {
+        uint32_t *filter =
+            callocator_alloc(cmap->_allocator, blocks * block_bytes, _CM_FILTER_ALIGN);
+        _CMREQUIRE(filter || cmap->_filter, return _CMFALSE);
+        if (filter) {
+            callocator_free(cmap->_allocator, cmap->_filter, cmap->_filter_blocks * block_bytes);
+            cmap->_filter = filter;
+            cmap->_filter_blocks = blocks;
+        }
+    }
+    memset(cmap->_filter, 0, cmap->_filter_blocks * block_bytes);
+    cmap->_filter_stale = 0;
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        _CMFOR(i, 0, cmap->_capacity, 1) {
+            if (!(cmap->_ctrl[i] & _CM_CTRL_EMPTY)) {
+                _cmap_filter_add(
+                    cmap, cmap->_hashes ? cmap->_hashes[i] : cmap->_hash_func(cmap->_slots[i].key)
+                );
+            }
+        }
+    } else if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        _CMFOR(i, 0, cmap->_used, 1) {
+            if (cmap->_entries[i].key != (void *)_CMSENTINEL) {
+                _cmap_filter_add(cmap, cmap->_hashes[i]);
+            }
+        }
+    } else {
+        _CMFOR(i, 0, cmap->_capacity, 1) {
+            cmap_bucket_t *bucket = _CMBUCKET(cmap, cmap->_buckets, i);
+            const size_t tbkt_capacity = bucket->_overflow_capacity + _CM_INLINE_SIZE;
+            _CMFOR(j, 0, bucket->_occupied ? tbkt_capacity : 0, 1) {
+                if (_cmap_bucket_entry(bucket, j)->key != (void *)_CMSENTINEL) {
+                    _cmap_filter_add(cmap, _cmap_bucket_hash(cmap, bucket, j));
+                }
+            }
+        }
+    }
+    return _CMTRUE;
+}
+
+// Initializes a given pointer with a cmap_t instance, using the given options.
+_CMSTCINL _Bool cmap_init_ex(
     cmap_t **map,
     size_t key_size,
     size_t val_size,
@@ -148,35 +735,142 @@ _CMSTCINL _Bool cmap_init(
     size_t (*hash_func)(const void *),
     int (*comparison_func)(const void *, const void *),
     void (*key_destructor)(void **),
-    void (*val_destructor)(void **)
+    void (*val_destructor)(void **),
+    const cmap_options_t *options
 ) {
+    const cmap_options_t defaults = {0};
+    _CMREQUIRE(options, options = &defaults);
     _CMREQUIRE(map && key_size && val_size && hash_func && comparison_func, return _CMFALSE);
     _CMREQUIRE(initial_capacity < SIZE_MAX / sizeof(cmap_bucket_t), return _CMFALSE);
     _CMREQUIRE(key_size <= sizeof(void *) && val_size <= sizeof(void *), return _CMFALSE);
+    _CMREQUIRE(
+        options->engine == CMAP_ENGINE_BUCKET || options->engine == CMAP_ENGINE_SWISS ||
+            options->engine == CMAP_ENGINE_COMPACT,
+        return _CMFALSE
+    );
+    _CMREQUIRE(
+        options->engine == CMAP_ENGINE_BUCKET || !(options->flags & CMAP_FLAG_INCREMENTAL_RESIZE),
+        return _CMFALSE
+    );
+    // Rebuilding the filter on resize would undo the point of an incremental one.
+    _CMREQUIRE(
+        !(options->flags & CMAP_FLAG_FILTER && options->flags & CMAP_FLAG_INCREMENTAL_RESIZE),
+        return _CMFALSE
+    );
+    _CMREQUIRE(options->shrink <= CMAP_SHRINK_NEVER, return _CMFALSE);
+    float max_load = options->max_load;
+    if (max_load == 0 && options->engine == CMAP_ENGINE_SWISS) {
+        max_load = _CMSWISS_LFACTOR_LIMIT;
+    } else if (max_load == 0 && options->engine == CMAP_ENGINE_COMPACT) {
+        max_load = _CMCOMPACT_LFACTOR_LIMIT;
+    } else if (max_load == 0) {
+        max_load = _CMLFACTOR_LIMIT;
+    }
+    float min_load = options->min_load;
+    if (min_load == 0) {
+        min_load = _CMLFACTOR_MIN < max_load / 2 ? _CMLFACTOR_MIN : max_load / 4;
+    }
+    // Open addressing needs a free slot to end its probes. Shrinking must not undo a growth step.
+    _CMREQUIRE(
+        max_load > 0 && (options->engine == CMAP_ENGINE_BUCKET || max_load < 1), return _CMFALSE
+    );
+    _CMREQUIRE(min_load > 0 && min_load < max_load / 2, return _CMFALSE);
     _CMREQUIRE(initial_capacity > 2, initial_capacity = 2);
-    cmap_t *cmap = malloc(sizeof(cmap_t));
+    if (options->engine == CMAP_ENGINE_SWISS) {
+        initial_capacity = _CMMAX(initial_capacity, _CM_GROUP_WIDTH);
+    }
+    cmap_t *cmap = callocator_alloc(options->allocator, sizeof(cmap_t), 0);
     size_t ncapacity = _cmap_nexp2(initial_capacity);
     _CMREQUIRE(cmap, return _CMFALSE);
     *cmap = (cmap_t){._buckets = NULL,
+                     ._old_buckets = NULL,
+                     ._old_capacity = 0,
+                     ._migrate_idx = 0,
+                     ._bucket_size = sizeof(cmap_bucket_t),
+                     ._pool = NULL,
+                     ._old_pool = NULL,
+                     ._ctrl = NULL,
+                     ._slots = NULL,
+                     ._hashes = NULL,
+                     ._tombstones = 0,
+                     ._entries = NULL,
+                     ._index = NULL,
+                     ._index_width = 0,
+                     ._used = 0,
+                     ._filter = NULL,
+                     ._filter_blocks = 0,
+                     ._filter_stale = 0,
                      ._size = 0,
                      ._capacity = ncapacity,
+                     ._engine = options->engine,
+                     ._flags = options->flags,
+                     ._max_load = max_load,
+                     ._min_load = min_load,
+                     ._shrink = options->shrink,
+                     ._reserved = 0,
+                     ._allocator = options->allocator,
                      ._key_size = key_size,
                      ._val_size = val_size,
                      ._hash_func = hash_func,
                      ._comparison_func = comparison_func,
                      ._key_destructor = key_destructor,
                      ._val_destructor = val_destructor};
-    cmap->_buckets = calloc(ncapacity, sizeof(cmap_bucket_t));
-    _CMREQUIRE(cmap->_buckets, free(cmap); return _CMFALSE);
-
-    _CMFOR(i, 0, initial_capacity, 1) {
-        cmap_bucket_t *bucket = &cmap->_buckets[i];
-        _CMFOR(j, 0, _CM_INLINE_SIZE, 1) { bucket->_inline_entries[j].key = (void *)_CMSENTINEL; }
+    _CMSTATS(memset(&cmap->_counters, 0, sizeof(cmap->_counters)));
+    if (cmap->_flags & CMAP_FLAG_CACHED_HASH) {
+        cmap->_bucket_size += _CM_INLINE_SIZE * sizeof(size_t);
+    }
+    const callocator_t *allocator = options->allocator;
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        uint8_t *ctrl = _cmap_swiss_alloc(cmap, ncapacity);
+        _CMREQUIRE(ctrl, callocator_free(allocator, cmap, sizeof(cmap_t)); return _CMFALSE);
+        _cmap_swiss_assign(cmap, ctrl, ncapacity);
+    } else if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        cmap_entry_t *entries = _cmap_compact_alloc(cmap, ncapacity);
+        _CMREQUIRE(entries, callocator_free(allocator, cmap, sizeof(cmap_t)); return _CMFALSE);
+        _cmap_compact_assign(cmap, entries, ncapacity);
+    } else {
+        _CMREQUIRE(
+            cpool_init_with(&cmap->_pool, allocator),
+            callocator_free(allocator, cmap, sizeof(cmap_t));
+            return _CMFALSE
+        );
+        cmap->_buckets = _cmap_bucket_alloc(cmap, ncapacity);
+        _CMREQUIRE(
+            cmap->_buckets, cpool_uninit(&cmap->_pool);
+            callocator_free(allocator, cmap, sizeof(cmap_t));
+            return _CMFALSE
+        );
+    }
+    if (!_cmap_filter_rebuild(cmap)) {
+        // Only the storage of the map's own engine was allocated, the rest is still NULL.
+        callocator_free(allocator, cmap->_ctrl, ncapacity * _cmap_swiss_slot_size(cmap));
+        callocator_free(allocator, cmap->_entries, _cmap_compact_bytes(cmap, ncapacity));
+        callocator_free(allocator, cmap->_buckets, ncapacity * cmap->_bucket_size);
+        cpool_uninit(&cmap->_pool);
+        callocator_free(allocator, cmap, sizeof(cmap_t));
+        return _CMFALSE;
     }
     *map = cmap;
     return _CMTRUE;
 }
 
+// Initializes a given pointer with a cmap_t instance.
+_CMSTCINL _Bool cmap_init(
+    cmap_t **map,
+    size_t key_size,
+    size_t val_size,
+    size_t initial_capacity,
+    size_t (*hash_func)(const void *),
+    int (*comparison_func)(const void *, const void *),
+    void (*key_destructor)(void **),
+    void (*val_destructor)(void **)
+) {
+    return cmap_init_ex(
+        map, key_size, val_size, initial_capacity, hash_func, comparison_func, key_destructor,
+        val_destructor, NULL
+    );
+}
+
 // Implementation detail.
 _CMSTCINL void _cmap_uninit_entry(cmap_entry_t *entry, cmap_t *map) {
     if (entry->key == (void *)_CMSENTINEL) {
@@ -190,231 +884,601 @@ _CMSTCINL void _cmap_uninit_entry(cmap_entry_t *entry, cmap_t *map) {
     }
 }
 
-// Uninitializes a pointer to a cmap_t instance.
-_CMSTCINL void cmap_uninit(cmap_t **map) {
-    _CMREQUIRE(map && *map, return);
-    cmap_t *cmap = *map;
-    _CMFOR(i, 0, cmap->_capacity, 1) {
-        if (!cmap->_buckets[i]._occupied) {
-            continue;
-        }
-        cmap_bucket_t *bucket = &(cmap->_buckets[i]);
-        _CMFOR(j, 0, _CM_INLINE_SIZE, 1) {
-            _cmap_uninit_entry(&(bucket->_inline_entries[j]), cmap);
+// Destroys the entries of a bucket array, then releases the array along with its overflow pool.
+_CMSTCINL void
+_cmap_bucket_destroy(cmap_t *cmap, cmap_bucket_t *buckets, size_t capacity, cpool_t **pool) {
+    _CMFOR(i, 0, capacity, 1) {
+        cmap_bucket_t *bucket = _CMBUCKET(cmap, buckets, i);
+        if (bucket->_occupied) {
+            _CMFOR(j, 0, _CM_INLINE_SIZE, 1) {
+                _cmap_uninit_entry(&(bucket->_inline_entries[j]), cmap);
+            }
         }
         if (!bucket->_overflow_entries) {
-            continue;
+            continue; // Emptied buckets may still hold on to their overflow storage.
         }
         _CMFOR(j, 0, bucket->_overflow_capacity, 1) {
             _cmap_uninit_entry(&(bucket->_overflow_entries[j]), cmap);
         }
-        free(bucket->_overflow_entries);
     }
-    free(cmap->_buckets);
-    free(cmap);
+    _cmap_bucket_free(cmap, buckets, capacity);
+    cpool_uninit(pool);
+}
+
+// Uninitializes a pointer to a cmap_t instance.
+_CMSTCINL void cmap_uninit(cmap_t **map) {
+    _CMREQUIRE(map && *map, return);
+    cmap_t *cmap = *map;
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        _CMFOR(i, 0, cmap->_capacity, 1) {
+            if (!(cmap->_ctrl[i] & _CM_CTRL_EMPTY)) {
+                _cmap_uninit_entry(&cmap->_slots[i], cmap);
+            }
+        }
+        callocator_free(
+            cmap->_allocator, cmap->_ctrl, cmap->_capacity * _cmap_swiss_slot_size(cmap)
+        );
+    } else if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        _CMFOR(i, 0, cmap->_used, 1) { _cmap_uninit_entry(&cmap->_entries[i], cmap); }
+        callocator_free(
+            cmap->_allocator, cmap->_entries, _cmap_compact_bytes(cmap, cmap->_capacity)
+        );
+    } else {
+        _cmap_bucket_destroy(cmap, cmap->_buckets, cmap->_capacity, &cmap->_pool);
+        if (cmap->_old_buckets) {
+            _cmap_bucket_destroy(cmap, cmap->_old_buckets, cmap->_old_capacity, &cmap->_old_pool);
+        }
+    }
+    callocator_free(
+        cmap->_allocator, cmap->_filter,
+        cmap->_filter_blocks * _CM_FILTER_WORDS * sizeof(uint32_t)
+    );
+    callocator_free(cmap->_allocator, cmap, sizeof(cmap_t));
     *map = NULL;
 }
 
-// Allocates a new array if given pointer is NULL, else reallocates.
-_CMSTCINL _Bool _cmap_mdfd_n2exp_alloc(void **arr, size_t nsize, size_t esize, size_t *out_ncap) {
+// Allocates a new array from a pool if given pointer is NULL, else reallocates it within the pool.
+_CMSTCINL _Bool _cmap_mdfd_n2exp_alloc(
+    cpool_t **pool, void **arr, size_t size, size_t nsize, size_t esize, size_t *out_ncap
+) {
     _CMREQUIRE(arr && nsize * esize != 0, return _CMFALSE);
     size_t nexp2_size = _cmap_nexp2(nsize);
     size_t alloc_size = nexp2_size * esize;
-    void *tmp = NULL;
-    if (*arr) {
-        tmp = realloc(*arr, alloc_size);
-    } else {
-        tmp = malloc(alloc_size);
-    }
+    void *tmp = cpool_realloc(pool, *arr, size * esize, alloc_size);
     _CMREQUIRE(tmp, return _CMFALSE);
     *arr = tmp;
     *out_ncap = nexp2_size;
     return _CMTRUE;
 }
 
-_CMSTCINL _Bool cmap_insert(cmap_t **map, void *key, void *value);
+// Finds the slot of a swiss table that should receive a key that is known to be absent.
+_CMSTCINL size_t _cmap_swiss_free_slot(const uint8_t *ctrl, size_t capacity, size_t hash) {
+    const size_t group_mask = capacity / _CM_GROUP_WIDTH - 1;
+    size_t group = (hash >> 7) & group_mask;
+    for (size_t probe = 1;; ++probe) {
+        const uint32_t free_mask = _cmap_group_free(ctrl + group * _CM_GROUP_WIDTH);
+        if (free_mask) {
+            return group * _CM_GROUP_WIDTH + _cmap_ctz32(free_mask);
+        }
+        group = (group + probe) & group_mask; // Triangular probing visits every group once.
+    }
+}
 
-// Resizes a given map to a given size.
-_CMSTCINL _Bool cmap_resize(cmap_t **map, size_t nsize) {
-    _CMREQUIRE(map && *map, return _CMFALSE);
-    size_t new_capacity = _cmap_nexp2(nsize);
-    cmap_t *cmap = *map;
-    size_t prv_capacity = cmap->_capacity;
-    size_t prv_size = cmap->_size;
-    cmap_bucket_t *prv_buckets = cmap->_buckets;
-    cmap_bucket_t *new_buckets = calloc(new_capacity, sizeof(cmap_bucket_t));
-    _Bool ret = _CMTRUE;
-    _CMREQUIRE(new_buckets, return _CMFALSE);
+// Returns the smallest capacity that holds `nsize` entries below the map's maximum load factor.
+_CMSTCINL size_t _cmap_fit_capacity(const cmap_t *cmap, size_t nsize) {
+    const size_t capacity = _cmap_nexp2((size_t)(nsize / cmap->_max_load) + 1);
+    return _CMMAX(capacity, cmap->_engine == CMAP_ENGINE_SWISS ? _CM_GROUP_WIDTH : 2);
+}
 
-    _CMFOR(i, 0, new_capacity, 1) {
-        cmap_bucket_t *bucket = &new_buckets[i];
-        _CMFOR(j, 0, _CM_INLINE_SIZE, 1) { bucket->_inline_entries[j].key = (void *)_CMSENTINEL; }
+// Picks the capacity of a rebuild that an open-addressed table needs before its next insertion.
+// Tombstones are purged in place unless live entries alone warrant growing the table.
+_CMSTCINL size_t _cmap_rebuild_capacity(const cmap_t *cmap) {
+    if (cmap->_size + 1 > cmap->_capacity * cmap->_max_load / 2) {
+        return cmap->_capacity * 2;
     }
+    if (cmap->_shrink == CMAP_SHRINK_LAZY) {
+        // Leaves room to double before growing again.
+        const size_t nsize = _CMMAX((cmap->_size + 1) * 2, cmap->_reserved);
+        return _CMMIN(_cmap_fit_capacity(cmap, nsize), cmap->_capacity);
+    }
+    return cmap->_capacity;
+}
 
-    cmap->_buckets = new_buckets;
-    cmap->_capacity = new_capacity;
-    cmap->_size = 0; // Prevents ping-pong recursion by resetting the load factor.
-
-    _CMFOR(i, 0, prv_capacity, 1) {
-        if (!prv_buckets[i]._occupied) {
-            continue;
-        }
-        _CMFOR(j, 0, _CM_INLINE_SIZE, 1) {
-            cmap_entry_t *entry = &prv_buckets[i]._inline_entries[j];
-            if (entry->key == (void *)_CMSENTINEL) {
-                continue;
-            }
-            _CMREQUIRE(cmap_insert(map, entry->key, entry->value), ret = _CMFALSE; goto end);
-        }
-        if (!prv_buckets[i]._overflow_entries) {
+// Rebuilds a swiss table into `new_capacity` slots, dropping every tombstone along the way.
+_CMSTCINL _Bool _cmap_swiss_resize(cmap_t *cmap, size_t new_capacity) {
+    _CMSTATS(const uint64_t start = _cmap_stats_clock());
+    new_capacity = _cmap_nexp2(_CMMAX(new_capacity, _CM_GROUP_WIDTH));
+    _CMREQUIRE(cmap->_size < new_capacity * cmap->_max_load, return _CMFALSE);
+    uint8_t *new_ctrl = _cmap_swiss_alloc(cmap, new_capacity);
+    _CMREQUIRE(new_ctrl, return _CMFALSE);
+    cmap_entry_t *new_slots = (cmap_entry_t *)(new_ctrl + new_capacity);
+    size_t *new_hashes = (size_t *)(new_slots + new_capacity);
+    _CMFOR(i, 0, cmap->_capacity, 1) {
+        if (cmap->_ctrl[i] & _CM_CTRL_EMPTY) {
             continue;
         }
-        _CMFOR(j, 0, prv_buckets[i]._overflow_capacity, 1) {
-            cmap_entry_t *entry = &prv_buckets[i]._overflow_entries[j];
-            if (entry->key == (void *)_CMSENTINEL) {
-                continue;
-            }
-            _CMREQUIRE(cmap_insert(map, entry->key, entry->value), ret = _CMFALSE; goto end);
-        }
-    }
-end:
-    if (!ret) {
-        _CMFOR(i, 0, new_capacity, 1) {
-            cmap_bucket_t *bucket = &new_buckets[i];
-            _CMFOR(j, 0, _CM_INLINE_SIZE, 1) {
-                _cmap_uninit_entry(&bucket->_inline_entries[j], cmap);
-            }
-            if (new_buckets[i]._overflow_entries) {
-                _CMFOR(j, 0, new_buckets[i]._overflow_capacity, 1) {
-                    _cmap_uninit_entry(&bucket->_overflow_entries[j], cmap);
-                }
-                free(new_buckets[i]._overflow_entries);
-            }
+        const size_t hash =
+            cmap->_hashes ? cmap->_hashes[i] : cmap->_hash_func(cmap->_slots[i].key);
+        const size_t slot = _cmap_swiss_free_slot(new_ctrl, new_capacity, hash);
+        new_ctrl[slot] = (uint8_t)(hash & 0x7F);
+        new_slots[slot] = cmap->_slots[i];
+        if (cmap->_hashes) {
+            new_hashes[slot] = hash;
         }
-        free(new_buckets);
-        cmap->_buckets = prv_buckets;
-        cmap->_capacity = prv_capacity;
-        cmap->_size = prv_size;
-        return ret;
     }
-    _CMFOR(i, 0, prv_capacity, 1) {
-        if (prv_buckets[i]._overflow_entries) {
-            free(prv_buckets[i]._overflow_entries);
-        }
+    callocator_free(cmap->_allocator, cmap->_ctrl, cmap->_capacity * _cmap_swiss_slot_size(cmap));
+    _cmap_swiss_assign(cmap, new_ctrl, new_capacity);
+    cmap->_tombstones = 0;
+    _cmap_filter_rebuild(cmap);
+    _CMSTATS(_cmap_stats_resized(cmap, start, _CMTRUE));
+    return _CMTRUE;
+}
+
+// Finds the index slot of a compact table that should refer to a key that is known to be absent.
+// Slots of removed entries are reused, since the key cannot be found further along their probes.
+_CMSTCINL size_t _cmap_compact_free_slot(const cmap_t *cmap, size_t hash) {
+    const size_t mask = cmap->_capacity - 1;
+    size_t slot = hash & mask;
+    while (_cmap_index_get(cmap, slot) >= 0) {
+        slot = (slot + 1) & mask;
     }
-    free(prv_buckets);
-    return ret;
+    return slot;
 }
 
-// Inserts a key-value pair into the map. If a key already exists, replace the value.
-_CMSTCINL _Bool cmap_insert(cmap_t **map, void *key, void *value) {
-    _CMREQUIRE(map && *map, return _CMFALSE);
-    if ((float)(*map)->_size / (*map)->_capacity >= _CMLFACTOR_LIMIT) {
-        cmap_resize(map, (*map)->_capacity + 1);
+// Rebuilds a compact table into `new_capacity` index slots. Removed entries are purged by sliding
+// the live ones down, which keeps them in insertion order.
+_CMSTCINL _Bool _cmap_compact_resize(cmap_t *cmap, size_t new_capacity) {
+    _CMSTATS(const uint64_t start = _cmap_stats_clock());
+    new_capacity = _cmap_nexp2(_CMMAX(new_capacity, 2));
+    _CMREQUIRE(cmap->_size <= _cmap_compact_limit(cmap, new_capacity), return _CMFALSE);
+    cmap_entry_t *prv_entries = cmap->_entries;
+    const size_t *prv_hashes = cmap->_hashes;
+    const size_t prv_used = cmap->_used;
+    const size_t prv_bytes = _cmap_compact_bytes(cmap, cmap->_capacity);
+    if (new_capacity == cmap->_capacity) {
+        // Entries only ever slide down, so the purge can happen within the current allocation.
+        memset(cmap->_index, 0xFF, new_capacity * cmap->_index_width);
+    } else {
+        cmap_entry_t *new_entries = _cmap_compact_alloc(cmap, new_capacity);
+        _CMREQUIRE(new_entries, return _CMFALSE);
+        _cmap_compact_assign(cmap, new_entries, new_capacity);
     }
+    cmap->_used = 0;
+    _CMFOR(i, 0, prv_used, 1) {
+        if (prv_entries[i].key == (void *)_CMSENTINEL) {
+            continue;
+        }
+        const size_t hash = prv_hashes[i];
+        _cmap_index_set(cmap, _cmap_compact_free_slot(cmap, hash), (ptrdiff_t)cmap->_used);
+        cmap->_entries[cmap->_used] = prv_entries[i];
+        cmap->_hashes[cmap->_used++] = hash;
+    }
+    if (prv_entries != cmap->_entries) {
+        callocator_free(cmap->_allocator, prv_entries, prv_bytes);
+    }
+    _cmap_filter_rebuild(cmap);
+    _CMSTATS(_cmap_stats_resized(cmap, start, _CMTRUE));
+    return _CMTRUE;
+}
 
-    cmap_t *cmap = *map;
-    cmap_bucket_t *bucket = &cmap->_buckets[cmap->_hash_func(key) & (cmap->_capacity - 1)];
-    cmap_entry_t *insertion_slot = NULL;
-
-    // Bucket is empty.
+// Returns the entry of a key within a given bucket if found, else returns `NULL`. Adds the number
+// of examined entries to `probes`.
+_CMSTCINL cmap_entry_t *_cmap_bucket_scan(
+    cmap_t *cmap, cmap_bucket_t *bucket, const void *key, size_t hash, size_t *probes
+) {
     if (!bucket->_occupied) {
-        insertion_slot = &bucket->_inline_entries[0];
-        bucket->_occupied = _CMTRUE;
+        return NULL;
+    }
+    const _Bool cached = cmap->_flags & CMAP_FLAG_CACHED_HASH;
+    _CMFOR(i, 0, _CM_INLINE_SIZE, 1) {
+        if (bucket->_inline_entries[i].key == (void *)_CMSENTINEL) {
+            continue;
+        }
+        ++*probes;
+        if (cached && _CMINLINE_HASHES(bucket)[i] != hash) {
+            continue;
+        }
+        _CMSTAT_ADD(cmap, comparisons, 1);
+        if (cmap->_comparison_func(bucket->_inline_entries[i].key, key) == 0) {
+            return &bucket->_inline_entries[i];
+        }
+    }
+    if (!bucket->_overflow_entries) {
+        return NULL;
+    }
+    _CMFOR(i, 0, bucket->_overflow_capacity, 1) {
+        if (bucket->_overflow_entries[i].key == (void *)_CMSENTINEL) {
+            continue;
+        }
+        ++*probes;
+        if (cached && _CMOVERFLOW_HASHES(bucket)[i] != hash) {
+            continue;
+        }
+        _CMSTAT_ADD(cmap, comparisons, 1);
+        if (cmap->_comparison_func(bucket->_overflow_entries[i].key, key) == 0) {
+            return &bucket->_overflow_entries[i];
+        }
     }
+    return NULL;
+}
 
-    // Search for an empty slot in the inlined data.
-    if (!insertion_slot) {
-        _CMFOR(i, 0, _CM_INLINE_SIZE, 1) {
-            if (bucket->_inline_entries[i].key == (void *)_CMSENTINEL && !insertion_slot) {
-                insertion_slot = &bucket->_inline_entries[i];
-                break;
+// Returns the not-yet-migrated bucket of a hash during an incremental resize, else returns `NULL`.
+_CMSTCINL cmap_bucket_t *_cmap_old_bucket(cmap_t *cmap, size_t hash) {
+    if (!cmap->_old_buckets) {
+        return NULL;
+    }
+    const size_t idx = hash & (cmap->_old_capacity - 1);
+    return idx >= cmap->_migrate_idx ? _CMBUCKET(cmap, cmap->_old_buckets, idx) : NULL;
+}
+
+// Returns the entry of a key within a bucket-engine map if found, else returns `NULL`.
+// Both bucket arrays are consulted while an incremental resize is in progress.
+_CMSTCINL cmap_entry_t *
+_cmap_bucket_find(cmap_t *cmap, const void *key, size_t hash, cmap_bucket_t **out_bucket) {
+    cmap_bucket_t *bucket = _CMBUCKET(cmap, cmap->_buckets, hash & (cmap->_capacity - 1));
+    size_t probes = 0;
+    cmap_entry_t *entry = _cmap_bucket_scan(cmap, bucket, key, hash, &probes);
+    if (!entry && (bucket = _cmap_old_bucket(cmap, hash))) {
+        entry = _cmap_bucket_scan(cmap, bucket, key, hash, &probes);
+    }
+    _CMSTATS(_cmap_stats_probe(cmap, probes, entry != NULL));
+    if (out_bucket) {
+        *out_bucket = bucket;
+    }
+    return entry;
+}
+
+// Returns the entry of a key within a swiss-engine map if found, else returns `NULL`.
+_CMSTCINL cmap_entry_t *_cmap_swiss_find(cmap_t *cmap, const void *key, size_t hash) {
+    const size_t group_mask = cmap->_capacity / _CM_GROUP_WIDTH - 1;
+    const uint8_t tag = (uint8_t)(hash & 0x7F);
+    size_t group = (hash >> 7) & group_mask;
+    _CMFOR(probe, 1, group_mask + 2, 1) {
+        const uint8_t *ctrl = cmap->_ctrl + group * _CM_GROUP_WIDTH;
+        uint32_t match = _cmap_group_match(ctrl, tag);
+        while (match) {
+            const size_t slot = group * _CM_GROUP_WIDTH + _cmap_ctz32(match);
+            if ((!cmap->_hashes || cmap->_hashes[slot] == hash) &&
+                (_CMSTAT_ADD(cmap, comparisons, 1),
+                 cmap->_comparison_func(cmap->_slots[slot].key, key) == 0)) {
+                _CMSTATS(_cmap_stats_probe(cmap, probe, _CMTRUE));
+                return &cmap->_slots[slot];
             }
-            if (cmap->_comparison_func(bucket->_inline_entries[i].key, key) == 0) {
-                bucket->_inline_entries[i].value = value;
-                return _CMTRUE;
+            match &= match - 1;
+        }
+        if (_cmap_group_match(ctrl, _CM_CTRL_EMPTY)) {
+            _CMSTATS(_cmap_stats_probe(cmap, probe, _CMFALSE));
+            return NULL; // An empty slot ends the probe sequence.
+        }
+        group = (group + probe) & group_mask;
+    }
+    _CMSTATS(_cmap_stats_probe(cmap, group_mask + 1, _CMFALSE));
+    return NULL;
+}
+
+// Returns the entry of a key within a compact-engine map if found, else returns `NULL`. Writes the
+// index slot that refers to the entry to `out_slot`, if given.
+_CMSTCINL cmap_entry_t *
+_cmap_compact_find(cmap_t *cmap, const void *key, size_t hash, size_t *out_slot) {
+    const size_t mask = cmap->_capacity - 1;
+    size_t slot = hash & mask;
+    _CMFOR(probe, 1, cmap->_capacity + 1, 1) {
+        const ptrdiff_t idx = _cmap_index_get(cmap, slot);
+        if (idx == _CM_INDEX_EMPTY) {
+            _CMSTATS(_cmap_stats_probe(cmap, probe, _CMFALSE));
+            return NULL; // An empty index slot ends the probe sequence.
+        }
+        if (idx >= 0 && cmap->_hashes[idx] == hash &&
+            (_CMSTAT_ADD(cmap, comparisons, 1),
+             cmap->_comparison_func(cmap->_entries[idx].key, key) == 0)) {
+            _CMSTATS(_cmap_stats_probe(cmap, probe, _CMTRUE));
+            if (out_slot) {
+                *out_slot = slot;
             }
+            return &cmap->_entries[idx];
         }
+        slot = (slot + 1) & mask;
     }
+    _CMSTATS(_cmap_stats_probe(cmap, cmap->_capacity, _CMFALSE));
+    return NULL;
+}
 
-    // Search for a new slot in the overflow data.
-    if (!insertion_slot) {
-        if (!bucket->_overflow_entries) {
-            size_t ncapacity = 0;
-            _CMREQUIRE(
-                _cmap_mdfd_n2exp_alloc(
-                    (void **)&bucket->_overflow_entries, 2, sizeof(cmap_entry_t), &ncapacity
-                ),
-                return _CMFALSE
-            );
-            _CMFOR(i, 0, ncapacity, 1) { bucket->_overflow_entries[i].key = (void *)_CMSENTINEL; }
-            bucket->_overflow_capacity = ncapacity;
+// Dispatches a lookup with a precomputed hash to the map's engine.
+_CMSTCINL cmap_entry_t *_cmap_find(cmap_t *cmap, const void *key, size_t hash) {
+    if (cmap->_filter && !_cmap_filter_test(cmap, hash)) {
+        _CMSTAT_ADD(cmap, filtered, 1);
+        return NULL;
+    }
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        return _cmap_swiss_find(cmap, key, hash);
+    }
+    if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        return _cmap_compact_find(cmap, key, hash, NULL);
+    }
+    return _cmap_bucket_find(cmap, key, hash, NULL);
+}
+
+// Places a key that is known to be absent into a given bucket of the map's layout, growing its
+// overflow array within `pool`. `hash` is only read with CMAP_FLAG_CACHED_HASH.
+_CMSTCINL _Bool _cmap_bucket_place_in(
+    cmap_t *cmap, cmap_bucket_t *bucket, cpool_t **pool, void *key, void *value, size_t hash
+) {
+    const _Bool cached = cmap->_flags & CMAP_FLAG_CACHED_HASH;
+    size_t slot_idx = SIZE_MAX; // Inline entries first, followed by the overflow entries.
+
+    // Search for an empty slot in the inlined data.
+    bucket->_occupied = _CMTRUE;
+    _CMFOR(i, 0, _CM_INLINE_SIZE, 1) {
+        if (bucket->_inline_entries[i].key == (void *)_CMSENTINEL) {
+            slot_idx = i;
+            break;
         }
+    }
+
+    // Search for an empty slot in the overflow data.
+    if (slot_idx == SIZE_MAX && bucket->_overflow_entries) {
         _CMFOR(i, 0, bucket->_overflow_capacity, 1) {
-            if (bucket->_overflow_entries[i].key == (void *)_CMSENTINEL && !insertion_slot) {
-                insertion_slot = &bucket->_overflow_entries[i];
+            if (bucket->_overflow_entries[i].key == (void *)_CMSENTINEL) {
+                slot_idx = _CM_INLINE_SIZE + i;
                 break;
             }
-            if (cmap->_comparison_func(bucket->_overflow_entries[i].key, key) == 0) {
-                bucket->_overflow_entries[i].value = value;
-                return _CMTRUE;
-            }
         }
     }
 
-    // All slots are used, reallocate overflow and set insertion_slot to the end.
-    if (!insertion_slot) {
+    // All slots are used, (re)allocate overflow and set the slot to the end.
+    if (slot_idx == SIZE_MAX) {
+        const size_t prv_capacity = bucket->_overflow_capacity;
         size_t ncapacity = 0;
         _CMREQUIRE(
             _cmap_mdfd_n2exp_alloc(
-                (void **)&bucket->_overflow_entries, bucket->_overflow_capacity + 1,
-                sizeof(cmap_entry_t), &ncapacity
+                pool, (void **)&bucket->_overflow_entries, prv_capacity,
+                _CMMAX(prv_capacity + 1, 2), sizeof(cmap_entry_t) + (cached ? sizeof(size_t) : 0),
+                &ncapacity
             ),
+            bucket->_occupied = bucket->_total_entries > 0;
             return _CMFALSE
         );
-        _CMFOR(i, bucket->_overflow_capacity, ncapacity, 1) {
+        if (cached) {
+            // Cached hashes trail the entries, so they move along with the end of the array.
+            memmove(
+                bucket->_overflow_entries + ncapacity, bucket->_overflow_entries + prv_capacity,
+                prv_capacity * sizeof(size_t)
+            );
+        }
+        _CMFOR(i, prv_capacity, ncapacity, 1) {
             bucket->_overflow_entries[i].key = (void *)_CMSENTINEL;
         }
-        insertion_slot = &bucket->_overflow_entries[bucket->_overflow_capacity];
+        slot_idx = _CM_INLINE_SIZE + prv_capacity;
         bucket->_overflow_capacity = ncapacity;
     }
 
     // Insert element.
+    cmap_entry_t *insertion_slot = _cmap_bucket_entry(bucket, slot_idx);
     insertion_slot->key = key;
     insertion_slot->value = value;
+    if (cached && slot_idx < _CM_INLINE_SIZE) {
+        _CMINLINE_HASHES(bucket)[slot_idx] = hash;
+    } else if (cached) {
+        _CMOVERFLOW_HASHES(bucket)[slot_idx - _CM_INLINE_SIZE] = hash;
+    }
     ++bucket->_total_entries;
-    ++cmap->_size;
     return _CMTRUE;
 }
 
-// Returns a pointer to the key-value pair if found, else returns `NULL`.
-_CMSTCINL cmap_entry_t *cmap_get_entry(cmap_t **map, void *key) {
-    _CMREQUIRE(map && *map, return NULL);
-    cmap_t *cmap = *map;
-    cmap_bucket_t *bucket = &cmap->_buckets[cmap->_hash_func(key) & (cmap->_capacity - 1)];
-    if (!bucket->_occupied) {
-        return NULL;
-    }
-    _CMFOR(i, 0, _CM_INLINE_SIZE, 1) {
-        if (bucket->_inline_entries[i].key == (void *)_CMSENTINEL) {
-            continue;
-        }
-        if (cmap->_comparison_func(bucket->_inline_entries[i].key, key) == 0) {
-            return &bucket->_inline_entries[i];
+// Places a key that is known to be absent into the current bucket array. Does not update `_size`.
+_CMSTCINL _Bool _cmap_bucket_place(cmap_t *cmap, void *key, void *value, size_t hash) {
+    cmap_bucket_t *bucket = _CMBUCKET(cmap, cmap->_buckets, hash & (cmap->_capacity - 1));
+    return _cmap_bucket_place_in(cmap, bucket, &cmap->_pool, key, value, hash);
+}
+
+// Moves every entry of a bucket into the current bucket array, one entry at a time. A failure
+// leaves the remaining entries in place, so the bucket can be migrated again later.
+_CMSTCINL _Bool _cmap_bucket_move(cmap_t *cmap, cmap_bucket_t *bucket) {
+    if (bucket->_occupied) {
+        const size_t tbkt_capacity = bucket->_overflow_capacity + _CM_INLINE_SIZE;
+        _CMFOR(i, 0, tbkt_capacity, 1) {
+            cmap_entry_t *entry = _cmap_bucket_entry(bucket, i);
+            if (entry->key == (void *)_CMSENTINEL) {
+                continue;
+            }
+            _CMREQUIRE(
+                _cmap_bucket_place(
+                    cmap, entry->key, entry->value, _cmap_bucket_hash(cmap, bucket, i)
+                ),
+                return _CMFALSE
+            );
+            entry->key = (void *)_CMSENTINEL;
+            --bucket->_total_entries;
         }
     }
-    if (!bucket->_overflow_entries) {
-        return NULL;
+    // The overflow array is released along with the old pool once the migration completes.
+    bucket->_overflow_entries = NULL;
+    bucket->_overflow_capacity = 0;
+    bucket->_occupied = _CMFALSE;
+    return _CMTRUE;
+}
+
+// Migrates up to `nbuckets` buckets of an in-progress incremental resize.
+_CMSTCINL _Bool _cmap_migrate(cmap_t *cmap, size_t nbuckets) {
+    while (cmap->_old_buckets && nbuckets--) {
+        _CMREQUIRE(
+            _cmap_bucket_move(cmap, _CMBUCKET(cmap, cmap->_old_buckets, cmap->_migrate_idx)),
+            return _CMFALSE
+        );
+        if (++cmap->_migrate_idx == cmap->_old_capacity) {
+            _cmap_bucket_free(cmap, cmap->_old_buckets, cmap->_old_capacity);
+            cpool_uninit(&cmap->_old_pool);
+            cmap->_old_buckets = NULL;
+            cmap->_old_capacity = 0;
+            cmap->_migrate_idx = 0;
+        }
     }
-    _CMFOR(i, 0, bucket->_overflow_capacity, 1) {
-        if (bucket->_overflow_entries[i].key == (void *)_CMSENTINEL) {
+    return _CMTRUE;
+}
+
+// Rehashes every entry of a bucket-engine map into a new bucket array in a single pass. The new
+// array gets a fresh pool, so the previous overflow storage is released by dropping whole slabs.
+_CMSTCINL _Bool _cmap_bucket_rehash(cmap_t *cmap, size_t new_capacity) {
+    size_t prv_capacity = cmap->_capacity;
+    cmap_bucket_t *prv_buckets = cmap->_buckets;
+    cpool_t *prv_pool = cmap->_pool;
+    cpool_t *new_pool = NULL;
+    _CMREQUIRE(cpool_init_with(&new_pool, cmap->_allocator), return _CMFALSE);
+    cmap_bucket_t *new_buckets = _cmap_bucket_alloc(cmap, new_capacity);
+    _CMREQUIRE(new_buckets, cpool_uninit(&new_pool); return _CMFALSE);
+
+    cmap->_buckets = new_buckets;
+    cmap->_capacity = new_capacity;
+    cmap->_pool = new_pool;
+    _CMFOR(i, 0, prv_capacity, 1) {
+        cmap_bucket_t *bucket = _CMBUCKET(cmap, prv_buckets, i);
+        if (!bucket->_occupied) {
             continue;
         }
-        if (cmap->_comparison_func(bucket->_overflow_entries[i].key, key) == 0) {
-            return &bucket->_overflow_entries[i];
+        const size_t tbkt_capacity = bucket->_overflow_capacity + _CM_INLINE_SIZE;
+        _CMFOR(j, 0, tbkt_capacity, 1) {
+            cmap_entry_t *entry = _cmap_bucket_entry(bucket, j);
+            if (entry->key == (void *)_CMSENTINEL) {
+                continue;
+            }
+            const size_t hash = _cmap_bucket_hash(cmap, bucket, j);
+            if (!_cmap_bucket_place(cmap, entry->key, entry->value, hash)) {
+                // The entries are still owned by the previous buckets, so only storage is released.
+                _cmap_bucket_free(cmap, new_buckets, new_capacity);
+                cpool_uninit(&new_pool);
+                cmap->_buckets = prv_buckets;
+                cmap->_capacity = prv_capacity;
+                cmap->_pool = prv_pool;
+                return _CMFALSE;
+            }
         }
     }
-    return NULL;
+    _cmap_bucket_free(cmap, prv_buckets, prv_capacity);
+    cpool_uninit(&prv_pool);
+    return _CMTRUE;
+}
+
+// Resizes a bucket-engine map, either in one pass or by starting an incremental migration.
+_CMSTCINL _Bool _cmap_bucket_resize(cmap_t *cmap, size_t new_capacity, _Bool incremental) {
+    _CMSTATS(const uint64_t start = _cmap_stats_clock());
+    _CMREQUIRE(_cmap_migrate(cmap, SIZE_MAX), return _CMFALSE);
+    if (!incremental) {
+        const _Bool ret = _cmap_bucket_rehash(cmap, new_capacity);
+        if (ret) {
+            _cmap_filter_rebuild(cmap);
+        }
+        _CMSTATS(_cmap_stats_resized(cmap, start, ret));
+        return ret;
+    }
+    cpool_t *new_pool = NULL;
+    _CMREQUIRE(cpool_init_with(&new_pool, cmap->_allocator), return _CMFALSE);
+    cmap_bucket_t *new_buckets = _cmap_bucket_alloc(cmap, new_capacity);
+    _CMREQUIRE(new_buckets, cpool_uninit(&new_pool); return _CMFALSE);
+    cmap->_old_buckets = cmap->_buckets;
+    cmap->_old_capacity = cmap->_capacity;
+    cmap->_old_pool = cmap->_pool;
+    cmap->_migrate_idx = 0;
+    cmap->_buckets = new_buckets;
+    cmap->_capacity = new_capacity;
+    cmap->_pool = new_pool;
+    _CMSTATS(_cmap_stats_resized(cmap, start, _CMTRUE));
+    return _CMTRUE;
+}
+
+// Resizes a given map to a given size. Always completes before returning, even for maps
+// created with CMAP_FLAG_INCREMENTAL_RESIZE.
+_CMSTCINL _Bool cmap_resize(cmap_t **map, size_t nsize) {
+    _CMREQUIRE(map && *map, return _CMFALSE);
+    if ((*map)->_engine == CMAP_ENGINE_SWISS) {
+        return _cmap_swiss_resize(*map, nsize);
+    }
+    if ((*map)->_engine == CMAP_ENGINE_COMPACT) {
+        return _cmap_compact_resize(*map, nsize);
+    }
+    return _cmap_bucket_resize(*map, _cmap_nexp2(nsize), _CMFALSE);
+}
+
+// Inserts a key that is known to be absent into a swiss-engine map.
+_CMSTCINL _Bool _cmap_swiss_place(cmap_t *cmap, void *key, void *value, size_t hash) {
+    if (cmap->_size + cmap->_tombstones + 1 > cmap->_capacity * cmap->_max_load) {
+        _CMREQUIRE(_cmap_swiss_resize(cmap, _cmap_rebuild_capacity(cmap)), return _CMFALSE);
+    }
+    const size_t slot = _cmap_swiss_free_slot(cmap->_ctrl, cmap->_capacity, hash);
+    if (cmap->_ctrl[slot] == _CM_CTRL_DELETED) {
+        --cmap->_tombstones;
+    }
+    cmap->_ctrl[slot] = (uint8_t)(hash & 0x7F);
+    cmap->_slots[slot] = (cmap_entry_t){.key = key, .value = value};
+    if (cmap->_hashes) {
+        cmap->_hashes[slot] = hash;
+    }
+    ++cmap->_size;
+    return _CMTRUE;
+}
+
+// Appends a key that is known to be absent to a compact-engine map.
+_CMSTCINL _Bool _cmap_compact_place(cmap_t *cmap, void *key, void *value, size_t hash) {
+    if (cmap->_used == _cmap_compact_limit(cmap, cmap->_capacity)) {
+        _CMREQUIRE(_cmap_compact_resize(cmap, _cmap_rebuild_capacity(cmap)), return _CMFALSE);
+    }
+    _cmap_index_set(cmap, _cmap_compact_free_slot(cmap, hash), (ptrdiff_t)cmap->_used);
+    cmap->_entries[cmap->_used] = (cmap_entry_t){.key = key, .value = value};
+    cmap->_hashes[cmap->_used++] = hash;
+    ++cmap->_size;
+    return _CMTRUE;
+}
+
+// Places a key that is known to be absent with the map's engine, and records it in the filter.
+_CMSTCINL _Bool _cmap_place(cmap_t *cmap, void *key, void *value, size_t hash) {
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        _CMREQUIRE(_cmap_swiss_place(cmap, key, value, hash), return _CMFALSE);
+    } else if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        _CMREQUIRE(_cmap_compact_place(cmap, key, value, hash), return _CMFALSE);
+    } else {
+        _CMREQUIRE(_cmap_bucket_place(cmap, key, value, hash), return _CMFALSE);
+        ++cmap->_size;
+    }
+    if (cmap->_filter) {
+        _cmap_filter_add(cmap, hash);
+    }
+    return _CMTRUE;
+}
+
+// Grows a bucket-engine map that is at its load limit, or advances its incremental resize, ahead
+// of an insert. The other engines grow as they place.
+_CMSTCINL void _cmap_grow_for_insert(cmap_t *cmap) {
+    if (cmap->_engine != CMAP_ENGINE_BUCKET) {
+        return;
+    }
+    const _Bool incremental = cmap->_flags & CMAP_FLAG_INCREMENTAL_RESIZE;
+    if (cmap->_size >= cmap->_capacity * cmap->_max_load) {
+        _cmap_bucket_resize(cmap, cmap->_capacity * 2, incremental);
+    } else if (incremental) {
+        _cmap_migrate(cmap, _CM_MIGRATE_STEP);
+    }
+}
+
+// Inserts a key-value pair whose hash is already known. If a key already exists, replace the value.
+_CMSTCINL _Bool _cmap_insert_hashed(cmap_t *cmap, void *key, void *value, size_t hash) {
+    _cmap_grow_for_insert(cmap);
+    cmap_entry_t *entry = _cmap_find(cmap, key, hash);
+    if (entry) {
+        entry->value = value;
+        return _CMTRUE;
+    }
+    return _cmap_place(cmap, key, value, hash);
+}
+
+// Inserts a key-value pair into the map. If a key already exists, replace the value.
+_CMSTCINL _Bool cmap_insert(cmap_t **map, void *key, void *value) {
+    _CMREQUIRE(map && *map, return _CMFALSE);
+    return _cmap_insert_hashed(*map, key, value, (*map)->_hash_func(key));
+}
+
+// Returns a pointer to the key-value pair if found, else returns `NULL`.
+_CMSTCINL cmap_entry_t *cmap_get_entry(cmap_t **map, void *key) {
+    _CMREQUIRE(map && *map, return NULL);
+    return _cmap_find(*map, key, (*map)->_hash_func(key));
 }
 
 // Gets the value and assigns it to an out-parameter.
@@ -428,79 +1492,328 @@ _CMSTCINL _Bool cmap_get(cmap_t **map, void *key, void **out) {
     return _CMTRUE;
 }
 
-// Removes a specified key-value entry from the map.
-_CMSTCINL void cmap_remove(cmap_t **map, void *key) {
-    _CMREQUIRE(map && *map, return);
-    cmap_entry_t *entry = cmap_get_entry(map, key);
-    _CMREQUIRE(entry, return);
+// Hashes a batch of keys, dispatching to the vectorized integer hash when the map uses it.
+_CMSTCINL void _cmap_hash_batch(cmap_t *cmap, void *const *keys, size_t n, size_t *out_hashes) {
+    if (cmap->_hash_func == cmap_genhash) {
+        cmap_genhash_batch(keys, n, out_hashes);
+        return;
+    }
+    _CMFOR(i, 0, n, 1) { out_hashes[i] = cmap->_hash_func(keys[i]); }
+}
+
+// Issues prefetches for everything a batch of lookups is about to touch. Buckets are requested
+// first so that their overflow pointers are likely resident by the time the second pass reads them.
+_CMSTCINL void _cmap_prefetch_batch(cmap_t *cmap, const size_t *hashes, size_t n) {
+    if (cmap->_filter) {
+        _CMFOR(i, 0, n, 1) { _CMPREFETCH(_cmap_filter_block(cmap, hashes[i])); }
+    }
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        const size_t group_mask = cmap->_capacity / _CM_GROUP_WIDTH - 1;
+        _CMFOR(i, 0, n, 1) {
+            const size_t slot = ((hashes[i] >> 7) & group_mask) * _CM_GROUP_WIDTH;
+            _CMPREFETCH(cmap->_ctrl + slot);
+            _CMPREFETCH(cmap->_slots + slot);
+        }
+        return;
+    }
+    if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        // The entries are only known once the index is read, so the index alone is prefetched.
+        _CMFOR(i, 0, n, 1) {
+            const size_t slot = hashes[i] & (cmap->_capacity - 1);
+            _CMPREFETCH((const char *)cmap->_index + slot * cmap->_index_width);
+        }
+        return;
+    }
+    _CMFOR(i, 0, n, 1) {
+        _CMPREFETCH(_CMBUCKET(cmap, cmap->_buckets, hashes[i] & (cmap->_capacity - 1)));
+    }
+    _CMFOR(i, 0, n, 1) {
+        const cmap_bucket_t *bucket =
+            _CMBUCKET(cmap, cmap->_buckets, hashes[i] & (cmap->_capacity - 1));
+        if (bucket->_overflow_entries) {
+            _CMPREFETCH(bucket->_overflow_entries);
+        }
+    }
+}
+
+// Grows a map, if needed, so that `nsize` entries fit without another rehash.
+_CMSTCINL _Bool _cmap_reserve(cmap_t *cmap, size_t nsize, _Bool incremental) {
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        _CMREQUIRE(nsize + cmap->_tombstones >= cmap->_capacity * cmap->_max_load, return _CMTRUE);
+        return _cmap_swiss_resize(cmap, _CMMAX(_cmap_fit_capacity(cmap, nsize), cmap->_capacity));
+    }
+    if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        const size_t removed = cmap->_used - cmap->_size;
+        _CMREQUIRE(nsize + removed > _cmap_compact_limit(cmap, cmap->_capacity), return _CMTRUE);
+        return _cmap_compact_resize(cmap, _CMMAX(_cmap_fit_capacity(cmap, nsize), cmap->_capacity));
+    }
+    _CMREQUIRE(nsize >= cmap->_capacity * cmap->_max_load, return _CMTRUE);
+    return _cmap_bucket_resize(cmap, _cmap_fit_capacity(cmap, nsize), incremental);
+}
+
+// Looks up a batch of keys. Each value is written to `out_values[i]` (NULL if the key is absent)
+// and, when `out_found` is given, whether it was found to `out_found[i]`. Keys are hashed and
+// their buckets prefetched in groups of _CM_BATCH_SIZE, so that the cache misses of a group
+// overlap instead of being paid one key at a time. Returns the number of keys found.
+_CMSTCINL size_t
+cmap_get_batch(cmap_t **map, void *const *keys, size_t n, void **out_values, _Bool *out_found) {
+    _CMREQUIRE(map && *map && (keys || !n) && (out_values || !n), return 0);
     cmap_t *cmap = *map;
+    size_t hashes[_CM_BATCH_SIZE];
+    size_t found = 0;
+    _CMFOR(base, 0, n, _CM_BATCH_SIZE) {
+        const size_t count = _CMMIN(n - base, _CM_BATCH_SIZE);
+        _cmap_hash_batch(cmap, keys + base, count, hashes);
+        _cmap_prefetch_batch(cmap, hashes, count);
+        _CMFOR(i, 0, count, 1) {
+            cmap_entry_t *entry = _cmap_find(cmap, keys[base + i], hashes[i]);
+            out_values[base + i] = entry ? entry->value : NULL;
+            if (out_found) {
+                out_found[base + i] = entry != NULL;
+            }
+            found += entry != NULL;
+        }
+    }
+    return found;
+}
+
+// Inserts a batch of key-value pairs, replacing the values of existing keys. The map is grown once
+// up front, then keys are hashed and prefetched in groups as in cmap_get_batch(). Stops at the
+// first allocation failure, leaving the preceding pairs inserted.
+_CMSTCINL _Bool cmap_insert_batch(cmap_t **map, void *const *keys, void *const *values, size_t n) {
+    _CMREQUIRE(map && *map && (keys || !n) && (values || !n), return _CMFALSE);
+    cmap_t *cmap = *map;
+    size_t hashes[_CM_BATCH_SIZE];
+    const _Bool incremental = cmap->_flags & CMAP_FLAG_INCREMENTAL_RESIZE;
+    _CMREQUIRE(
+        n <= SIZE_MAX - cmap->_size && _cmap_reserve(cmap, cmap->_size + n, incremental),
+        return _CMFALSE
+    );
+    _CMFOR(base, 0, n, _CM_BATCH_SIZE) {
+        const size_t count = _CMMIN(n - base, _CM_BATCH_SIZE);
+        if (cmap->_old_buckets) {
+            _cmap_migrate(cmap, _CM_MIGRATE_STEP * count);
+        }
+        _cmap_hash_batch(cmap, keys + base, count, hashes);
+        _cmap_prefetch_batch(cmap, hashes, count);
+        _CMFOR(i, 0, count, 1) {
+            void *key = keys[base + i];
+            void *value = values[base + i];
+            cmap_entry_t *entry = _cmap_find(cmap, key, hashes[i]);
+            if (entry) {
+                entry->value = value;
+            } else {
+                _CMREQUIRE(_cmap_place(cmap, key, value, hashes[i]), return _CMFALSE);
+            }
+        }
+    }
+    return _CMTRUE;
+}
+
+// Halves a map after a removal, if its shrink policy and reservation allow it.
+_CMSTCINL void _cmap_shrink(cmap_t *cmap) {
+    if (cmap->_filter_stale > cmap->_capacity * cmap->_max_load / 2) {
+        // Bloom filters cannot forget a key. Stale bits are cleared before they crowd the filter.
+        _cmap_filter_rebuild(cmap);
+    }
+    if (cmap->_shrink != CMAP_SHRINK_EAGER || cmap->_size >= cmap->_capacity * cmap->_min_load) {
+        return;
+    }
+    const size_t ncapacity = cmap->_capacity / 2;
+    if (ncapacity < _cmap_fit_capacity(cmap, _CMMAX(cmap->_size, cmap->_reserved))) {
+        return;
+    }
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        _cmap_swiss_resize(cmap, ncapacity);
+    } else if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        _cmap_compact_resize(cmap, ncapacity);
+    } else {
+        _cmap_bucket_resize(cmap, ncapacity, cmap->_flags & CMAP_FLAG_INCREMENTAL_RESIZE);
+    }
+}
+
+// Removes the entry of a key whose hash is already known. Returns whether the key was found.
+_CMSTCINL _Bool _cmap_remove_hashed(cmap_t *cmap, void *key, size_t hash) {
+    if (cmap->_old_buckets) {
+        _cmap_migrate(cmap, _CM_MIGRATE_STEP);
+    }
+    _CMREQUIRE(!cmap->_filter || _cmap_filter_test(cmap, hash), return _CMFALSE);
+    cmap_bucket_t *bucket = NULL;
+    size_t index_slot = 0;
+    cmap_entry_t *entry = NULL;
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        entry = _cmap_swiss_find(cmap, key, hash);
+    } else if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        entry = _cmap_compact_find(cmap, key, hash, &index_slot);
+    } else {
+        entry = _cmap_bucket_find(cmap, key, hash, &bucket);
+    }
+    _CMREQUIRE(entry, return _CMFALSE);
     if (cmap->_key_destructor) {
         cmap->_key_destructor((void **)&(entry->key));
     }
     if (cmap->_val_destructor) {
         cmap->_val_destructor((void **)&(entry->value));
     }
-    entry->key = (void *)_CMSENTINEL;
     --cmap->_size;
-    cmap_bucket_t *bucket = &cmap->_buckets[cmap->_hash_func(key) & (cmap->_capacity - 1)];
+    cmap->_filter_stale += cmap->_filter != NULL;
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        // A group that still has an empty slot never diverted a probe, so no tombstone is needed.
+        const size_t slot = (size_t)(entry - cmap->_slots);
+        const uint8_t *group = cmap->_ctrl + (slot & ~(size_t)(_CM_GROUP_WIDTH - 1));
+        if (_cmap_group_match(group, _CM_CTRL_EMPTY)) {
+            cmap->_ctrl[slot] = _CM_CTRL_EMPTY;
+        } else {
+            cmap->_ctrl[slot] = _CM_CTRL_DELETED;
+            ++cmap->_tombstones;
+        }
+        _cmap_shrink(cmap);
+        return _CMTRUE;
+    }
+    entry->key = (void *)_CMSENTINEL;
+    if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        // The entry stays in place until the next rebuild, so iteration order is unaffected.
+        _cmap_index_set(cmap, index_slot, _CM_INDEX_DUMMY);
+        _cmap_shrink(cmap);
+        return _CMTRUE;
+    }
     --bucket->_total_entries;
     if (!bucket->_total_entries) {
         bucket->_occupied = _CMFALSE;
     }
-    if ((float)cmap->_size / cmap->_capacity < _CMLFACTOR_MIN) {
-        cmap_resize(map, cmap->_capacity / 2);
-    }
+    _cmap_shrink(cmap);
+    return _CMTRUE;
 }
 
-_CMSTCINL _Bool cmap_iter_next(cmap_iterator_t *iter, cmap_entry_t *out) {
-    _CMREQUIRE(iter && out && iter->map && iter->bucket_idx < iter->map->_size, return _CMFALSE);
-    cmap_t *map = iter->map;
-    size_t bucket_idx = iter->bucket_idx;
-    size_t st_idx = iter->st_idx;
-    cmap_bucket_t *bucket = &map->_buckets[bucket_idx];
+// Removes a specified key-value entry from the map.
+_CMSTCINL void cmap_remove(cmap_t **map, void *key) {
+    _CMREQUIRE(map && *map, return);
+    _cmap_remove_hashed(*map, key, (*map)->_hash_func(key));
+}
 
-    ++st_idx; // Increment to possible next entry.
+// Grows the map so that it holds `n_entries` entries without rehashing, and keeps removals from
+// shrinking it below that. Completes any pending incremental resize first.
+_CMSTCINL _Bool cmap_reserve(cmap_t **map, size_t n_entries) {
+    _CMREQUIRE(map && *map, return _CMFALSE);
+    cmap_t *cmap = *map;
+    _CMREQUIRE(_cmap_migrate(cmap, SIZE_MAX), return _CMFALSE);
+    _CMREQUIRE(_cmap_reserve(cmap, n_entries, _CMFALSE), return _CMFALSE);
+    cmap->_reserved = n_entries;
+    return _CMTRUE;
+}
 
-    while (bucket_idx < map->_capacity) {
-        if (!bucket->_occupied) {
-            bucket = &map->_buckets[++bucket_idx];
-            continue;
+// Drops any reservation and shrinks the map to the smallest capacity that fits its entries.
+// Also purges the tombstones of a swiss-engine map, and the removed entries of a compact one.
+_CMSTCINL _Bool cmap_shrink_to_fit(cmap_t **map) {
+    _CMREQUIRE(map && *map, return _CMFALSE);
+    cmap_t *cmap = *map;
+    cmap->_reserved = 0;
+    const size_t ncapacity = _CMMIN(_cmap_fit_capacity(cmap, cmap->_size), cmap->_capacity);
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        _CMREQUIRE(ncapacity < cmap->_capacity || cmap->_tombstones, return _CMTRUE);
+        return _cmap_swiss_resize(cmap, ncapacity);
+    }
+    if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        _CMREQUIRE(ncapacity < cmap->_capacity || cmap->_used > cmap->_size, return _CMTRUE);
+        return _cmap_compact_resize(cmap, ncapacity);
+    }
+    _CMREQUIRE(ncapacity < cmap->_capacity || cmap->_old_buckets, return _CMTRUE);
+    return _cmap_bucket_resize(cmap, ncapacity, _CMFALSE);
+}
+
+// Empties a map without destroying its entries, whose ownership has moved elsewhere. Keeps the
+// capacity, but releases any overflow storage.
+_CMSTCINL void _cmap_forget(cmap_t *cmap) {
+    cmap->_size = 0;
+    if (cmap->_filter) {
+        memset(cmap->_filter, 0, cmap->_filter_blocks * _CM_FILTER_WORDS * sizeof(uint32_t));
+        cmap->_filter_stale = 0;
+    }
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        memset(cmap->_ctrl, _CM_CTRL_EMPTY, cmap->_capacity);
+        cmap->_tombstones = 0;
+        return;
+    }
+    if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        memset(cmap->_index, 0xFF, cmap->_capacity * cmap->_index_width);
+        cmap->_used = 0;
+        return;
+    }
+    if (cmap->_old_buckets) {
+        _cmap_bucket_free(cmap, cmap->_old_buckets, cmap->_old_capacity);
+        cpool_uninit(&cmap->_old_pool);
+        cmap->_old_buckets = NULL;
+        cmap->_old_capacity = 0;
+        cmap->_migrate_idx = 0;
+    }
+    cpool_reset(&cmap->_pool);
+    _CMFOR(i, 0, cmap->_capacity, 1) {
+        cmap_bucket_t *bucket = _CMBUCKET(cmap, cmap->_buckets, i);
+        *bucket = (cmap_bucket_t){._overflow_entries = NULL, ._occupied = _CMFALSE};
+        _CMFOR(j, 0, _CM_INLINE_SIZE, 1) {
+            bucket->_inline_entries[j].key = (void *)_CMSENTINEL;
         }
-        _Bool found = _CMFALSE;
+    }
+}
+
+// Advances the iterator to the first entry at or after its current position.
+_CMSTCINL _Bool _cmap_iter_seek(cmap_iterator_t *iter, cmap_entry_t *out) {
+    cmap_t *map = iter->map;
+    if (map->_engine == CMAP_ENGINE_SWISS) {
+        while (iter->bucket_idx < map->_capacity &&
+               (map->_ctrl[iter->bucket_idx] & _CM_CTRL_EMPTY)) {
+            ++iter->bucket_idx;
+        }
+        _CMREQUIRE(iter->bucket_idx < map->_capacity, return _CMFALSE);
+        *out = map->_slots[iter->bucket_idx];
+        return _CMTRUE;
+    }
+    if (map->_engine == CMAP_ENGINE_COMPACT) {
+        while (iter->bucket_idx < map->_used &&
+               map->_entries[iter->bucket_idx].key == (void *)_CMSENTINEL) {
+            ++iter->bucket_idx;
+        }
+        _CMREQUIRE(iter->bucket_idx < map->_used, return _CMFALSE);
+        *out = map->_entries[iter->bucket_idx];
+        return _CMTRUE;
+    }
+    // Buckets past `_capacity` index into `_old_buckets` while an incremental resize is pending.
+    while (iter->bucket_idx < map->_capacity + map->_old_capacity) {
+        cmap_bucket_t *bucket =
+            iter->bucket_idx < map->_capacity
+                ? _CMBUCKET(map, map->_buckets, iter->bucket_idx)
+                : _CMBUCKET(map, map->_old_buckets, iter->bucket_idx - map->_capacity);
         size_t tbkt_capacity = bucket->_overflow_capacity + _CM_INLINE_SIZE;
-        while (st_idx < tbkt_capacity) {
-            if (st_idx < _CM_INLINE_SIZE &&
-                bucket->_inline_entries[st_idx].key != (void *)_CMSENTINEL) {
-                found = _CMTRUE;
-                break;
-            } else if (st_idx >= _CM_INLINE_SIZE &&
-                       bucket->_overflow_entries[st_idx - _CM_INLINE_SIZE].key !=
-                           (void *)_CMSENTINEL) {
-                found = _CMTRUE;
-                break;
+        while (bucket->_occupied && iter->st_idx < tbkt_capacity) {
+            const cmap_entry_t *entry = _cmap_bucket_entry(bucket, iter->st_idx);
+            if (entry->key != (void *)_CMSENTINEL) {
+                *out = *entry;
+                return _CMTRUE;
             }
-            ++st_idx;
-        }
-        if (found) {
-            break;
-        } else if (st_idx == tbkt_capacity) {
-            bucket = &map->_buckets[++bucket_idx];
-            st_idx = 0;
+            ++iter->st_idx;
         }
+        ++iter->bucket_idx;
+        iter->st_idx = 0;
     }
-    if (bucket_idx == map->_size) {
-        iter->bucket_idx = bucket_idx;
-        iter->st_idx = st_idx;
-        return _CMFALSE;
+    return _CMFALSE;
+}
+
+_CMSTCINL _Bool cmap_iter_next(cmap_iterator_t *iter, cmap_entry_t *out) {
+    _CMREQUIRE(
+        iter && out && iter->map &&
+            iter->bucket_idx < iter->map->_capacity + iter->map->_old_capacity,
+        return _CMFALSE
+    );
+    if (iter->map->_engine != CMAP_ENGINE_BUCKET) {
+        ++iter->bucket_idx;
+    } else {
+        ++iter->st_idx; // Increment to possible next entry.
     }
-    cmap_entry_t *arr = st_idx < _CM_INLINE_SIZE ? map->_buckets[bucket_idx]._inline_entries
-                                                 : map->_buckets[bucket_idx]._overflow_entries;
-    *out = arr[st_idx - ((st_idx < _CM_INLINE_SIZE) ? 0 : _CM_INLINE_SIZE)];
-    iter->bucket_idx = bucket_idx;
-    iter->st_idx = st_idx;
-    return _CMTRUE;
+    return _cmap_iter_seek(iter, out);
 }
 
+// Starts iterating over a map. Lookups may be interleaved with the iteration, as they never move
+// entries, but inserts and removes may not.
 _CMSTCINL _Bool cmap_iter_start(cmap_t **map, cmap_iterator_t *iter, cmap_entry_t *out) {
     _CMREQUIRE(map && *map && iter && out, return _CMFALSE);
     _CMREQUIRE((*map)->_size > 0, return _CMFALSE);
@@ -508,19 +1821,123 @@ _CMSTCINL _Bool cmap_iter_start(cmap_t **map, cmap_iterator_t *iter, cmap_entry_
     iter->bucket_idx = 0;
     iter->map = *map;
     iter->st_idx = 0;
+    return _cmap_iter_seek(iter, out);
+}
 
+// Writes a snapshot of a map's shape and counters to an out-parameter. Walks every bucket (or
+// control byte), so it is meant for diagnostics rather than hot paths.
+_CMSTCINL _Bool cmap_stats(cmap_t **map, cmap_stats_t *out) {
+    _CMREQUIRE(map && *map && out, return _CMFALSE);
     cmap_t *cmap = *map;
-    if (cmap->_buckets[0]._inline_entries[0].key != (void *)_CMSENTINEL) {
-        *out = cmap->_buckets[0]._inline_entries[0];
+    memset(out, 0, sizeof(cmap_stats_t));
+    out->engine = cmap->_engine;
+    out->size = cmap->_size;
+    out->capacity = cmap->_capacity;
+    out->filter_bytes = cmap->_filter_blocks * _CM_FILTER_WORDS * sizeof(uint32_t);
+    if (cmap->_engine == CMAP_ENGINE_SWISS) {
+        out->tombstones = cmap->_tombstones;
+        _CMFOR(group, 0, cmap->_capacity, _CM_GROUP_WIDTH) {
+            size_t entries = 0;
+            _CMFOR(i, group, group + _CM_GROUP_WIDTH, 1) {
+                entries += !(cmap->_ctrl[i] & _CM_CTRL_EMPTY);
+            }
+            ++out->occupancy[_CMMIN(entries, CMAP_STATS_BINS - 1)];
+        }
+    } else if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        out->tombstones = cmap->_used - cmap->_size;
+        size_t run = 0; // Runs of used index slots, which lookups probe linearly.
+        _CMFOR(i, 0, cmap->_capacity + 1, 1) {
+            if (i < cmap->_capacity && _cmap_index_get(cmap, i) != _CM_INDEX_EMPTY) {
+                ++run;
+            } else if (run) {
+                ++out->occupancy[_CMMIN(run, CMAP_STATS_BINS - 1)];
+                run = 0;
+            }
+        }
     } else {
-        _CMREQUIRE(cmap_iter_next(iter, out), return _CMFALSE);
+        _CMFOR(i, 0, cmap->_capacity + cmap->_old_capacity, 1) {
+            const cmap_bucket_t *bucket =
+                i < cmap->_capacity ? _CMBUCKET(cmap, cmap->_buckets, i)
+                                    : _CMBUCKET(cmap, cmap->_old_buckets, i - cmap->_capacity);
+            const size_t entries = bucket->_occupied ? bucket->_total_entries : 0;
+            if (i < cmap->_capacity) {
+                ++out->occupancy[_CMMIN(entries, CMAP_STATS_BINS - 1)];
+            }
+            if (bucket->_overflow_entries) {
+                ++out->overflow_arrays;
+                out->overflow_slots += bucket->_overflow_capacity;
+                out->overflow_entries += entries > _CM_INLINE_SIZE ? entries - _CM_INLINE_SIZE : 0;
+            }
+        }
     }
+#if defined(CMAP_ENABLE_STATS)
+    out->counters_enabled = _CMTRUE;
+    _CMFOR(i, 0, CMAP_STATS_BINS, 1) {
+        out->hit_probes[i] =
+            atomic_load_explicit(&cmap->_counters.hit_probes[i], memory_order_relaxed);
+        out->miss_probes[i] =
+            atomic_load_explicit(&cmap->_counters.miss_probes[i], memory_order_relaxed);
+    }
+    out->comparisons = atomic_load_explicit(&cmap->_counters.comparisons, memory_order_relaxed);
+    out->filtered = atomic_load_explicit(&cmap->_counters.filtered, memory_order_relaxed);
+    out->resizes = atomic_load_explicit(&cmap->_counters.resizes, memory_order_relaxed);
+    out->resize_ns = atomic_load_explicit(&cmap->_counters.resize_ns, memory_order_relaxed);
+#endif
     return _CMTRUE;
 }
 
+// Implementation detail. Prints a histogram as a JSON array, or as space-separated counts.
+_CMSTCINL void _cmap_stats_dump_bins(FILE *file, const size_t *bins, _Bool json) {
+    fputs(json ? "[" : "", file);
+    _CMFOR(i, 0, CMAP_STATS_BINS, 1) {
+        fprintf(file, "%s%zu", i == 0 ? "" : json ? ", " : " ", bins[i]);
+    }
+    fputs(json ? "]" : "", file);
+}
+
+// Prints a stats snapshot to a file as human-readable text or as a single JSON object.
+_CMSTCINL _Bool cmap_stats_dump(const cmap_stats_t *stats, FILE *file, cmap_stats_format_t format) {
+    _CMREQUIRE(stats && file, return _CMFALSE);
+    const _Bool json = format == CMAP_STATS_JSON;
+    const char *fmt = json ? "%s\"%s\": %zu" : "%s%s: %zu";
+    const char *sep = json ? ", " : "\n";
+    fputs(json ? "{" : "", file);
+    fprintf(
+        file, json ? "\"engine\": \"%s\"" : "engine: %s",
+        stats->engine == CMAP_ENGINE_SWISS     ? "swiss"
+        : stats->engine == CMAP_ENGINE_COMPACT ? "compact"
+                                               : "bucket"
+    );
+    fprintf(file, fmt, sep, "size", stats->size);
+    fprintf(file, fmt, sep, "capacity", stats->capacity);
+    fprintf(file, fmt, sep, "overflow_arrays", stats->overflow_arrays);
+    fprintf(file, fmt, sep, "overflow_slots", stats->overflow_slots);
+    fprintf(file, fmt, sep, "overflow_entries", stats->overflow_entries);
+    fprintf(file, fmt, sep, "tombstones", stats->tombstones);
+    fprintf(file, fmt, sep, "filter_bytes", stats->filter_bytes);
+    fprintf(file, json ? "%s\"occupancy\": " : "%soccupancy: ", sep);
+    _cmap_stats_dump_bins(file, stats->occupancy, json);
+    if (stats->counters_enabled) {
+        fprintf(file, json ? "%s\"hit_probes\": " : "%shit_probes: ", sep);
+        _cmap_stats_dump_bins(file, stats->hit_probes, json);
+        fprintf(file, json ? "%s\"miss_probes\": " : "%smiss_probes: ", sep);
+        _cmap_stats_dump_bins(file, stats->miss_probes, json);
+        fprintf(file, fmt, sep, "comparisons", stats->comparisons);
+        fprintf(file, fmt, sep, "filtered", stats->filtered);
+        fprintf(file, fmt, sep, "resizes", stats->resizes);
+        fprintf(
+            file, json ? "%s\"resize_ns\": %llu" : "%sresize_ns: %llu", sep,
+            (unsigned long long)stats->resize_ns
+        );
+    }
+    fputs(json ? "}\n" : "\n", file);
+    return !ferror(file);
+}
+
 // Macro API accessors.
 #define CMAP_SIZE(map) (map->_size)
 #define CMAP_CAPACITY(map) (map->_capacity)
+#define CMAP_ENGINE(map) (map->_engine)
 #define CMAP_BUCKETS(map) (map->_buckets)
 #define CMAP_KEY_SIZE(map) (map->_key_size)
 #define CMAP_VALUE_SIZE(map) (map->_val_size)
@@ -534,11 +1951,227 @@ _CMSTCINL _Bool cmap_iter_start(cmap_t **map, cmap_iterator_t *iter, cmap_entry_
     (cmap_init(                                                                                    \
         &map, sizeof(key_type), sizeof(val_type), init_capacity, hash_func, cmp_func, kdtor, vdtor \
     ))
+#define CMAP_INIT_EX(                                                                              \
+    map, key_type, val_type, init_capacity, hash_func, cmp_func, kdtor, vdtor, options             \
+)                                                                                                  \
+    (cmap_init_ex(                                                                                 \
+        &map, sizeof(key_type), sizeof(val_type), init_capacity, hash_func, cmp_func, kdtor,       \
+        vdtor, options                                                                             \
+    ))
 #define CMAP_UNINIT(map) (cmap_uninit(&map))
 #define CMAP_INSERT(map, key, value) (cmap_insert(&map, (void *)key, (void *)value))
 #define CMAP_REMOVE(map, key) (cmap_remove(&map, (void *)key))
 #define CMAP_GETENTRY(map, key) (cmap_get_entry(&map, (void *)key))
 #define CMAP_GETVAL(map, key, out) (cmap_get(&map, (void *)key, (void **)&out))
+#define CMAP_GET_BATCH(map, keys, n, out_values, out_found)                                        \
+    (cmap_get_batch(&map, (void *const *)keys, n, (void **)out_values, out_found))
+#define CMAP_INSERT_BATCH(map, keys, values, n)                                                    \
+    (cmap_insert_batch(&map, (void *const *)keys, (void *const *)values, n))
 #define CMAP_RESIZE(map, nsize) (cmap_resize(&map, nsize))
+#define CMAP_RESERVE(map, n_entries) (cmap_reserve(&map, n_entries))
+#define CMAP_SHRINK_TO_FIT(map) (cmap_shrink_to_fit(&map))
+#define CMAP_STATS(map, out) (cmap_stats(&map, &out))
+#define CMAP_STRKEY(str) (cmap_strkey(str, strlen(str)))
 #define CMAP_ITER_START(map, iter, out) (cmap_iter_start(&map, &iter, &out))
-#define CMAP_ITER_NEXT(iter, out) (cmap_iter_next(&iter, &out))
\ No newline at end of file
+#define CMAP_ITER_NEXT(iter, out) (cmap_iter_next(&iter, &out))
+/*
+    Typed map generator. CMAP_DECLARE(name, K, V, hash_fn, eq_fn) emits `name_t`, a swiss table
+    that stores `K` and `V` by value at any size, with `hash_fn` and `eq_fn` called directly so
+    they can be inlined. `hash_fn` has the shape `size_t (const K *)` and `eq_fn` the shape
+    `_Bool (const K *, const K *)`, returning `true` for equal keys. Either may be a macro.
+    Keys and values are copied in by assignment and nothing is destroyed on removal. Slots follow
+    the control bytes at the entry's alignment, so over-aligned `K` or `V` (e.g. SIMD vectors) are
+    supported.
+    Emits name_init, name_uninit, name_resize, name_insert, name_get (returns `V *` or `NULL`),
+    name_remove, name_iter_start and name_iter_next. Expand it at file scope, without a semicolon.
+*/
+#define CMAP_DECLARE(name, K, V, hash_fn, eq_fn)                                                   \
+    typedef struct {                                                                               \
+        K key;                                                                                     \
+        V value;                                                                                   \
+    } name##_entry_t;                                                                              \
+                                                                                                   \
+    typedef struct {                                                                               \
+        uint8_t *_ctrl;                                                                            \
+        name##_entry_t *_slots;                                                                    \
+        size_t _tombstones;                                                                        \
+        size_t _size;                                                                              \
+        size_t _capacity;                                                                          \
+    } name##_t;                                                                                    \
+                                                                                                   \
+    typedef struct {                                                                               \
+        name##_t *map;                                                                             \
+        size_t slot_idx;                                                                           \
+    } name##_iterator_t;                                                                           \
+                                                                                                   \
+    _CMSTCINL size_t _##name##_slots_offset(size_t capacity) {                                     \
+        return (capacity + _Alignof(name##_entry_t) - 1) & ~(_Alignof(name##_entry_t) - 1);        \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL uint8_t *_##name##_alloc(size_t capacity) {                                          \
+        const size_t offset = _##name##_slots_offset(capacity);                                    \
+        _CMREQUIRE(capacity < (SIZE_MAX - offset) / sizeof(name##_entry_t), return NULL);          \
+        uint8_t *ctrl = callocator_alloc(                                                          \
+            NULL, offset + capacity * sizeof(name##_entry_t), _Alignof(name##_entry_t)             \
+        );                                                                                         \
+        _CMREQUIRE(ctrl, return NULL);                                                             \
+        memset(ctrl, _CM_CTRL_EMPTY, capacity);                                                    \
+        return ctrl;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL void _##name##_free(uint8_t *ctrl, size_t capacity) {                                \
+        const size_t bytes = _##name##_slots_offset(capacity) + capacity * sizeof(name##_entry_t); \
+        callocator_free(NULL, ctrl, bytes);                                                        \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL name##_entry_t *_##name##_find(name##_t *map, const K *key, size_t hash) {           \
+        const size_t group_mask = map->_capacity / _CM_GROUP_WIDTH - 1;                            \
+        const uint8_t tag = (uint8_t)(hash & 0x7F);                                                \
+        size_t group = (hash >> 7) & group_mask;                                                   \
+        _CMFOR(probe, 1, group_mask + 2, 1) {                                                      \
+            const uint8_t *ctrl = map->_ctrl + group * _CM_GROUP_WIDTH;                            \
+            uint32_t match = _cmap_group_match(ctrl, tag);                                         \
+            while (match) {                                                                        \
+                const size_t slot = group * _CM_GROUP_WIDTH + _cmap_ctz32(match);                  \
+                if (eq_fn(&map->_slots[slot].key, key)) {                                          \
+                    return &map->_slots[slot];                                                     \
+                }                                                                                  \
+                match &= match - 1;                                                                \
+            }                                                                                      \
+            if (_cmap_group_match(ctrl, _CM_CTRL_EMPTY)) {                                         \
+                return NULL;                                                                       \
+            }                                                                                      \
+            group = (group + probe) & group_mask;                                                  \
+        }                                                                                          \
+        return NULL;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL _Bool name##_init(name##_t **map, size_t initial_capacity) {                         \
+        _CMREQUIRE(map, return _CMFALSE);                                                          \
+        const size_t capacity = _cmap_nexp2(_CMMAX(initial_capacity, _CM_GROUP_WIDTH));            \
+        name##_t *tmap = malloc(sizeof(name##_t));                                                 \
+        _CMREQUIRE(tmap, return _CMFALSE);                                                         \
+        tmap->_ctrl = _##name##_alloc(capacity);                                                   \
+        _CMREQUIRE(tmap->_ctrl, free(tmap); return _CMFALSE);                                      \
+        tmap->_slots = (name##_entry_t *)(tmap->_ctrl + _##name##_slots_offset(capacity));         \
+        tmap->_tombstones = 0;                                                                     \
+        tmap->_size = 0;                                                                           \
+        tmap->_capacity = capacity;                                                                \
+        *map = tmap;                                                                               \
+        return _CMTRUE;                                                                            \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL void name##_uninit(name##_t **map) {                                                 \
+        _CMREQUIRE(map && *map, return);                                                           \
+        _##name##_free((*map)->_ctrl, (*map)->_capacity);                                          \
+        free(*map);                                                                                \
+        *map = NULL;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL _Bool name##_resize(name##_t **map, size_t nsize) {                                  \
+        _CMREQUIRE(map && *map, return _CMFALSE);                                                  \
+        name##_t *tmap = *map;                                                                     \
+        const size_t new_capacity = _cmap_nexp2(_CMMAX(nsize, _CM_GROUP_WIDTH));                   \
+        _CMREQUIRE(tmap->_size < new_capacity * _CMSWISS_LFACTOR_LIMIT, return _CMFALSE);          \
+        uint8_t *new_ctrl = _##name##_alloc(new_capacity);                                         \
+        _CMREQUIRE(new_ctrl, return _CMFALSE);                                                     \
+        name##_entry_t *new_slots =                                                                \
+            (name##_entry_t *)(new_ctrl + _##name##_slots_offset(new_capacity));                   \
+        _CMFOR(i, 0, tmap->_capacity, 1) {                                                         \
+            if (tmap->_ctrl[i] & _CM_CTRL_EMPTY) {                                                 \
+                continue;                                                                          \
+            }                                                                                      \
+            const size_t hash = hash_fn(&tmap->_slots[i].key);                                     \
+            const size_t slot = _cmap_swiss_free_slot(new_ctrl, new_capacity, hash);               \
+            new_ctrl[slot] = (uint8_t)(hash & 0x7F);                                               \
+            new_slots[slot] = tmap->_slots[i];                                                     \
+        }                                                                                          \
+        _##name##_free(tmap->_ctrl, tmap->_capacity);                                              \
+        tmap->_ctrl = new_ctrl;                                                                    \
+        tmap->_slots = new_slots;                                                                  \
+        tmap->_tombstones = 0;                                                                     \
+        tmap->_capacity = new_capacity;                                                            \
+        return _CMTRUE;                                                                            \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL _Bool name##_insert(name##_t **map, const K *key, const V *value) {                  \
+        _CMREQUIRE(map && *map && key && value, return _CMFALSE);                                  \
+        name##_t *tmap = *map;                                                                     \
+        const size_t hash = hash_fn(key);                                                          \
+        name##_entry_t *entry = _##name##_find(tmap, key, hash);                                   \
+        if (entry) {                                                                               \
+            entry->value = *value;                                                                 \
+            return _CMTRUE;                                                                        \
+        }                                                                                          \
+        if (tmap->_size + tmap->_tombstones + 1 > tmap->_capacity * _CMSWISS_LFACTOR_LIMIT) {      \
+            const _Bool grow = tmap->_size + 1 > tmap->_capacity * _CMSWISS_LFACTOR_LIMIT / 2;     \
+            _CMREQUIRE(                                                                            \
+                name##_resize(map, grow ? tmap->_capacity * 2 : tmap->_capacity), return _CMFALSE  \
+            );                                                                                     \
+        }                                                                                          \
+        const size_t slot = _cmap_swiss_free_slot(tmap->_ctrl, tmap->_capacity, hash);             \
+        if (tmap->_ctrl[slot] == _CM_CTRL_DELETED) {                                               \
+            --tmap->_tombstones;                                                                   \
+        }                                                                                          \
+        tmap->_ctrl[slot] = (uint8_t)(hash & 0x7F);                                                \
+        tmap->_slots[slot].key = *key;                                                             \
+        tmap->_slots[slot].value = *value;                                                         \
+        ++tmap->_size;                                                                             \
+        return _CMTRUE;                                                                            \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL V *name##_get(name##_t **map, const K *key) {                                        \
+        _CMREQUIRE(map && *map && key, return NULL);                                               \
+        name##_entry_t *entry = _##name##_find(*map, key, hash_fn(key));                           \
+        return entry ? &entry->value : NULL;                                                       \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL _Bool name##_remove(name##_t **map, const K *key) {                                  \
+        _CMREQUIRE(map && *map && key, return _CMFALSE);                                           \
+        name##_t *tmap = *map;                                                                     \
+        name##_entry_t *entry = _##name##_find(tmap, key, hash_fn(key));                           \
+        _CMREQUIRE(entry, return _CMFALSE);                                                        \
+        const size_t slot = (size_t)(entry - tmap->_slots);                                        \
+        if (_cmap_group_match(                                                                     \
+                tmap->_ctrl + (slot & ~(size_t)(_CM_GROUP_WIDTH - 1)), _CM_CTRL_EMPTY              \
+            )) {                                                                                   \
+            tmap->_ctrl[slot] = _CM_CTRL_EMPTY;                                                    \
+        } else {                                                                                   \
+            tmap->_ctrl[slot] = _CM_CTRL_DELETED;                                                  \
+            ++tmap->_tombstones;                                                                   \
+        }                                                                                          \
+        --tmap->_size;                                                                             \
+        if ((float)tmap->_size / tmap->_capacity < _CMLFACTOR_MIN &&                               \
+            tmap->_capacity > _CM_GROUP_WIDTH) {                                                   \
+            name##_resize(map, tmap->_capacity / 2);                                               \
+        }                                                                                          \
+        return _CMTRUE;                                                                            \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL _Bool _##name##_iter_seek(name##_iterator_t *iter, name##_entry_t **out) {           \
+        name##_t *map = iter->map;                                                                 \
+        while (iter->slot_idx < map->_capacity &&                                                  \
+               (map->_ctrl[iter->slot_idx] & _CM_CTRL_EMPTY)) {                                    \
+            ++iter->slot_idx;                                                                      \
+        }                                                                                          \
+        _CMREQUIRE(iter->slot_idx < map->_capacity, return _CMFALSE);                              \
+        *out = &map->_slots[iter->slot_idx];                                                       \
+        return _CMTRUE;                                                                            \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL _Bool name##_iter_next(name##_iterator_t *iter, name##_entry_t **out) {              \
+        _CMREQUIRE(                                                                                \
+            iter && out && iter->map && iter->slot_idx < iter->map->_capacity, return _CMFALSE     \
+        );                                                                                         \
+        ++iter->slot_idx;                                                                          \
+        return _##name##_iter_seek(iter, out);                                                     \
+    }                                                                                              \
+                                                                                                   \
+    _CMSTCINL _Bool name##_iter_start(                                                             \
+        name##_t **map, name##_iterator_t *iter, name##_entry_t **out                              \
+    ) {                                                                                            \
+        _CMREQUIRE(map && *map && iter && out, return _CMFALSE);                                   \
+        iter->map = *map;                                                                          \
+        iter->slot_idx = 0;                                                                        \
+        return _##name##_iter_seek(iter, out);                                                     \
+    }
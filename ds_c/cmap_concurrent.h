@@ -0,0 +1,241 @@
+/*  cmap_concurrent.h
+ *  A sharded, thread-safe hashmap built on top of cmap.h.
+ *  Requires POSIX threads (e.g. -std=gnu11, or _POSIX_C_SOURCE >= 200112L with -std=c11, which
+ *  this header defines itself when included first).
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+// Strict ISO modes (e.g. -std=c11) hide POSIX. Takes effect when included before system headers.
+#if defined(__STRICT_ANSI__) && !defined(_POSIX_C_SOURCE) && !defined(_XOPEN_SOURCE) &&            \
+    !defined(_GNU_SOURCE) && !defined(_DEFAULT_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "cmap.h"
+
+#include <pthread.h>
+
+#define _CMC_SHARD_ALIGN 64 // Keeps each shard's lock on its own cache line.
+
+// A single shard. Readers share the lock, writers (and resizes) take it exclusively.
+typedef struct {
+    _Alignas(_CMC_SHARD_ALIGN) pthread_rwlock_t _lock;
+    cmap_t *_map;
+} cmap_shard_t;
+
+typedef struct {
+    cmap_shard_t *_shards;
+    size_t _shard_count; // Power of two.
+    unsigned _shard_shift;
+    size_t (*_hash_func)(const void *);
+} cmap_concurrent_t;
+
+// Selects a shard from the high bits of a hash. The low bits stay free for the shard's buckets.
+_CMSTCINL cmap_shard_t *_cmap_concurrent_shard(cmap_concurrent_t *cmap, size_t hash) {
+    if (cmap->_shard_count == 1) {
+        return &cmap->_shards[0];
+    }
+    return &cmap->_shards[hash >> cmap->_shard_shift];
+}
+
+// Releases the first `count` shards of a map along with the map itself.
+_CMSTCINL void _cmap_concurrent_free(cmap_concurrent_t *cmap, size_t count) {
+    _CMFOR(i, 0, count, 1) {
+        cmap_uninit(&cmap->_shards[i]._map);
+        pthread_rwlock_destroy(&cmap->_shards[i]._lock);
+    }
+    free(cmap->_shards);
+    free(cmap);
+}
+
+/*
+    Initializes a given pointer with a cmap_concurrent_t instance.
+    `shard_count` is rounded up to a power of two, and `initial_capacity` is split across shards.
+    Every shard is a cmap_t created with `options`. With CMAP_FLAG_INCREMENTAL_RESIZE, a shard's
+    rehashing advances only under its write lock, as lookups leave the map untouched. The allocator
+    of `options`, if any, is shared by the shards and must be thread-safe.
+*/
+_CMSTCINL _Bool cmap_concurrent_init(
+    cmap_concurrent_t **map,
+    size_t shard_count,
+    size_t key_size,
+    size_t val_size,
+    size_t initial_capacity,
+    size_t (*hash_func)(const void *),
+    int (*comparison_func)(const void *, const void *),
+    void (*key_destructor)(void **),
+    void (*val_destructor)(void **),
+    const cmap_options_t *options
+) {
+    _CMREQUIRE(map && hash_func && shard_count, return _CMFALSE);
+    _CMREQUIRE(shard_count <= SIZE_MAX / 2 / sizeof(cmap_shard_t), return _CMFALSE);
+    shard_count = _cmap_nexp2(shard_count);
+    cmap_concurrent_t *cmap = malloc(sizeof(cmap_concurrent_t));
+    _CMREQUIRE(cmap, return _CMFALSE);
+    cmap->_shards = aligned_alloc(_CMC_SHARD_ALIGN, shard_count * sizeof(cmap_shard_t));
+    _CMREQUIRE(cmap->_shards, free(cmap); return _CMFALSE);
+    cmap->_shard_count = shard_count;
+    cmap->_shard_shift = sizeof(size_t) * 8;
+    cmap->_hash_func = hash_func;
+    for (size_t n = shard_count; n > 1; n >>= 1) {
+        --cmap->_shard_shift;
+    }
+
+    _CMFOR(i, 0, shard_count, 1) {
+        cmap_shard_t *shard = &cmap->_shards[i];
+        if (pthread_rwlock_init(&shard->_lock, NULL) != 0) {
+            _cmap_concurrent_free(cmap, i);
+            return _CMFALSE;
+        }
+        const _Bool ok = cmap_init_ex(
+            &shard->_map, key_size, val_size, initial_capacity / shard_count, hash_func,
+            comparison_func, key_destructor, val_destructor, options
+        );
+        if (!ok) {
+            pthread_rwlock_destroy(&shard->_lock);
+            _cmap_concurrent_free(cmap, i);
+            return _CMFALSE;
+        }
+    }
+    *map = cmap;
+    return _CMTRUE;
+}
+
+// Uninitializes a pointer to a cmap_concurrent_t instance. Must not race with any other call.
+_CMSTCINL void cmap_concurrent_uninit(cmap_concurrent_t **map) {
+    _CMREQUIRE(map && *map, return);
+    _cmap_concurrent_free(*map, (*map)->_shard_count);
+    *map = NULL;
+}
+
+// Inserts a key-value pair into the map. If a key already exists, replace the value.
+_CMSTCINL _Bool cmap_concurrent_insert(cmap_concurrent_t **map, void *key, void *value) {
+    _CMREQUIRE(map && *map, return _CMFALSE);
+    const size_t hash = (*map)->_hash_func(key);
+    cmap_shard_t *shard = _cmap_concurrent_shard(*map, hash);
+    pthread_rwlock_wrlock(&shard->_lock);
+    const _Bool ret = _cmap_insert_hashed(shard->_map, key, value, hash);
+    pthread_rwlock_unlock(&shard->_lock);
+    return ret;
+}
+
+// Gets the value and assigns it to an out-parameter. Concurrent readers of a shard do not block
+// each other.
+_CMSTCINL _Bool cmap_concurrent_get(cmap_concurrent_t **map, void *key, void **out) {
+    _CMREQUIRE(map && *map && out, return _CMFALSE);
+    const size_t hash = (*map)->_hash_func(key);
+    cmap_shard_t *shard = _cmap_concurrent_shard(*map, hash);
+    pthread_rwlock_rdlock(&shard->_lock);
+    cmap_entry_t *entry = _cmap_find(shard->_map, key, hash);
+    if (entry) {
+        *out = entry->value;
+    }
+    pthread_rwlock_unlock(&shard->_lock);
+    return entry != NULL;
+}
+
+// Removes a specified key-value entry from the map.
+_CMSTCINL void cmap_concurrent_remove(cmap_concurrent_t **map, void *key) {
+    _CMREQUIRE(map && *map, return);
+    const size_t hash = (*map)->_hash_func(key);
+    cmap_shard_t *shard = _cmap_concurrent_shard(*map, hash);
+    pthread_rwlock_wrlock(&shard->_lock);
+    _cmap_remove_hashed(shard->_map, key, hash);
+    pthread_rwlock_unlock(&shard->_lock);
+}
+
+/*
+    Atomically returns the value of a key, inserting `value` first if the key is absent.
+    `out_inserted` (optional) reports whether the pair was inserted. If it was not, the caller
+    keeps ownership of `key` and `value`.
+*/
+_CMSTCINL _Bool cmap_concurrent_get_or_insert(
+    cmap_concurrent_t **map, void *key, void *value, void **out, _Bool *out_inserted
+) {
+    _CMREQUIRE(map && *map && out, return _CMFALSE);
+    const size_t hash = (*map)->_hash_func(key);
+    cmap_shard_t *shard = _cmap_concurrent_shard(*map, hash);
+    _Bool ret = _CMTRUE;
+    pthread_rwlock_wrlock(&shard->_lock);
+    cmap_entry_t *entry = _cmap_find(shard->_map, key, hash);
+    if (entry) {
+        *out = entry->value;
+    } else {
+        _cmap_grow_for_insert(shard->_map); // The key is known to be absent, so no second lookup.
+        if ((ret = _cmap_place(shard->_map, key, value, hash))) {
+            *out = value;
+        }
+    }
+    pthread_rwlock_unlock(&shard->_lock);
+    if (out_inserted) {
+        *out_inserted = ret && !entry;
+    }
+    return ret;
+}
+
+/*
+    Atomically updates the value of a key through a callback, while its shard is write-locked.
+    `update_func` receives the current value and `exists == true` if the key is present, or a
+    NULL value and `exists == false` otherwise. Returning `true` for an absent key
+    inserts it with the value written by the callback. Returns `false` if the key was neither
+    present nor inserted, or if the insertion failed.
+*/
+_CMSTCINL _Bool cmap_concurrent_update(
+    cmap_concurrent_t **map,
+    void *key,
+    _Bool (*update_func)(void **value, _Bool exists, void *ctx),
+    void *ctx
+) {
+    _CMREQUIRE(map && *map && update_func, return _CMFALSE);
+    const size_t hash = (*map)->_hash_func(key);
+    cmap_shard_t *shard = _cmap_concurrent_shard(*map, hash);
+    _Bool ret = _CMTRUE;
+    pthread_rwlock_wrlock(&shard->_lock);
+    cmap_entry_t *entry = _cmap_find(shard->_map, key, hash);
+    if (entry) {
+        update_func(&entry->value, _CMTRUE, ctx);
+    } else {
+        void *value = NULL;
+        ret = update_func(&value, _CMFALSE, ctx);
+        if (ret) {
+            _cmap_grow_for_insert(shard->_map);
+            ret = _cmap_place(shard->_map, key, value, hash);
+        }
+    }
+    pthread_rwlock_unlock(&shard->_lock);
+    return ret;
+}
+
+// Returns the number of entries across all shards. Only a snapshot while writers are active.
+_CMSTCINL size_t cmap_concurrent_size(cmap_concurrent_t **map) {
+    _CMREQUIRE(map && *map, return 0);
+    size_t size = 0;
+    _CMFOR(i, 0, (*map)->_shard_count, 1) {
+        cmap_shard_t *shard = &(*map)->_shards[i];
+        pthread_rwlock_rdlock(&shard->_lock);
+        size += shard->_map->_size;
+        pthread_rwlock_unlock(&shard->_lock);
+    }
+    return size;
+}
+
+// Macro API accessors.
+#define CMAP_CONCURRENT_SHARD_COUNT(map) (map->_shard_count)
+
+// Macro API functions.
+#define CMAP_CONCURRENT_INIT(                                                                      \
+    map, shards, key_type, val_type, init_capacity, hash_func, cmp_func, kdtor, vdtor, options     \
+)                                                                                                  \
+    (cmap_concurrent_init(                                                                         \
+        &map, shards, sizeof(key_type), sizeof(val_type), init_capacity, hash_func, cmp_func,      \
+        kdtor, vdtor, options                                                                      \
+    ))
+#define CMAP_CONCURRENT_UNINIT(map) (cmap_concurrent_uninit(&map))
+#define CMAP_CONCURRENT_INSERT(map, key, value)                                                    \
+    (cmap_concurrent_insert(&map, (void *)key, (void *)value))
+#define CMAP_CONCURRENT_REMOVE(map, key) (cmap_concurrent_remove(&map, (void *)key))
+#define CMAP_CONCURRENT_GETVAL(map, key, out)                                                      \
+    (cmap_concurrent_get(&map, (void *)key, (void **)&out))
+#define CMAP_CONCURRENT_SIZE(map) (cmap_concurrent_size(&map))
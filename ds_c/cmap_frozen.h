@@ -0,0 +1,312 @@
+/*  cmap_frozen.h
+ *  A frozen, memory-mappable, read-only image of a cmap_t.
+ *  Requires POSIX mmap (e.g. -std=gnu11, or _POSIX_C_SOURCE >= 200112L with -std=c11, which this
+ *  header defines itself when included first).
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+// Strict ISO modes (e.g. -std=c11) hide POSIX. Takes effect when included before system headers.
+#if defined(__STRICT_ANSI__) && !defined(_POSIX_C_SOURCE) && !defined(_XOPEN_SOURCE) &&            \
+    !defined(_GNU_SOURCE) && !defined(_DEFAULT_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "cmap.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define _CMF_MAGIC "CMAPFRZ"
+#define _CMF_VERSION 1u
+#define _CMF_BYTE_ORDER 0x0102030405060708ULL // Reads back differently on a foreign byte order.
+#define _CMF_GROUP_WIDTH 16 // Fixed, so images do not depend on the ISA they were built with.
+#define _CMF_LFACTOR_LIMIT 0.875
+#define _CMF_ALIGN 16
+
+// How a key or value of a frozen map is stored.
+typedef enum {
+    CMAP_FROZEN_INLINE = 0, // The pointer-sized payload itself, as with cmap_genhash() keys.
+    CMAP_FROZEN_CSTR,       // A NUL-terminated string, copied into the image's string arena.
+} cmap_frozen_kind_t;
+
+// On-disk header. Every offset is relative to the start of the file, so the image can be mapped
+// at any address.
+typedef struct {
+    char magic[8];
+    uint64_t byte_order;
+    uint32_t version;
+    uint8_t key_kind;
+    uint8_t val_kind;
+    uint8_t word_size; // sizeof(size_t) of the producer. Hashes are only stable within one.
+    uint8_t _reserved;
+    uint64_t size;
+    uint64_t capacity; // Slots. A power of two and a multiple of _CMF_GROUP_WIDTH.
+    uint64_t ctrl_offset;
+    uint64_t slots_offset;
+    uint64_t arena_offset;
+    uint64_t arena_size;
+    uint64_t file_size;
+} cmap_frozen_header_t;
+
+// On-disk slot. CMAP_FROZEN_CSTR payloads hold the file offset of their string.
+typedef struct {
+    uint64_t key;
+    uint64_t value;
+} cmap_frozen_slot_t;
+
+typedef struct {
+    const uint8_t *_base; // Start of the mapping.
+    size_t _length;
+    const cmap_frozen_header_t *_header;
+    const uint8_t *_ctrl;
+    const cmap_frozen_slot_t *_slots;
+} cmap_frozen_t;
+
+_CMSTCINL uint64_t _cmap_frozen_align(uint64_t offset) {
+    return (offset + _CMF_ALIGN - 1) & ~(uint64_t)(_CMF_ALIGN - 1);
+}
+
+// Returns a bitmask of the slots in a 16-byte control group that are equal to `tag`.
+_CMSTCINL uint32_t _cmap_frozen_match(const uint8_t *ctrl, uint8_t tag) {
+#if defined(__SSE2__)
+    const __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#else
+    uint32_t mask = 0;
+    _CMFOR(i, 0, _CMF_GROUP_WIDTH, 1) { mask |= (uint32_t)(ctrl[i] == tag) << i; }
+    return mask;
+#endif
+}
+
+// Hashes a key the way the image was built, independently of the source map's hash function.
+_CMSTCINL size_t _cmap_frozen_hash(cmap_frozen_kind_t kind, const void *key) {
+    return kind == CMAP_FROZEN_CSTR ? cmap_strhash(key) : cmap_genhash(key);
+}
+
+/*
+    Serializes a populated map into a frozen image at `path`, replacing it atomically: the image
+    is written and synced to a uniquely named file next to `path` (from mkstemp()), then renamed
+    over `path`. Concurrent freezes of the same path do not interfere, the last rename wins, and
+    processes that still map the previous image keep reading it unchanged.
+    `key_kind` and `val_kind` describe how the map's keys and values are stored. CMAP_FROZEN_CSTR
+    payloads are copied into a string arena, so the image holds no pointers. The source map's
+    hash and comparison functions are not used: the image hashes CMAP_FROZEN_INLINE keys with
+    cmap_genhash() and CMAP_FROZEN_CSTR keys with cmap_strhash().
+*/
+_CMSTCINL _Bool cmap_freeze(
+    cmap_t **map, const char *path, cmap_frozen_kind_t key_kind, cmap_frozen_kind_t val_kind
+) {
+    _CMREQUIRE(map && *map && path, return _CMFALSE);
+    _CMREQUIRE(key_kind <= CMAP_FROZEN_CSTR && val_kind <= CMAP_FROZEN_CSTR, return _CMFALSE);
+    cmap_t *cmap = *map;
+    cmap_iterator_t iter;
+    cmap_entry_t entry;
+
+    // First pass, sizes the string arena.
+    uint64_t arena_size = 0;
+    for (_Bool ok = cmap_iter_start(map, &iter, &entry); ok; ok = cmap_iter_next(&iter, &entry)) {
+        if (key_kind == CMAP_FROZEN_CSTR) {
+            arena_size += strlen((const char *)entry.key) + 1;
+        }
+        if (val_kind == CMAP_FROZEN_CSTR) {
+            arena_size += strlen((const char *)entry.value) + 1;
+        }
+    }
+
+    uint64_t capacity = _CMF_GROUP_WIDTH;
+    while (cmap->_size >= capacity * _CMF_LFACTOR_LIMIT) {
+        capacity *= 2;
+    }
+    cmap_frozen_header_t header = {
+        .magic = _CMF_MAGIC,
+        .byte_order = _CMF_BYTE_ORDER,
+        .version = _CMF_VERSION,
+        .key_kind = (uint8_t)key_kind,
+        .val_kind = (uint8_t)val_kind,
+        .word_size = (uint8_t)sizeof(size_t),
+        ._reserved = 0,
+        .size = cmap->_size,
+        .capacity = capacity,
+    };
+    header.ctrl_offset = _cmap_frozen_align(sizeof(cmap_frozen_header_t));
+    header.slots_offset = _cmap_frozen_align(header.ctrl_offset + capacity);
+    header.arena_offset = header.slots_offset + capacity * sizeof(cmap_frozen_slot_t);
+    header.arena_size = arena_size;
+    header.file_size = header.arena_offset + arena_size;
+    _CMREQUIRE(header.file_size <= SIZE_MAX, return _CMFALSE);
+
+    uint8_t *image = calloc(1, (size_t)header.file_size);
+    _CMREQUIRE(image, return _CMFALSE);
+    memcpy(image, &header, sizeof(header));
+    uint8_t *ctrl = image + header.ctrl_offset;
+    cmap_frozen_slot_t *slots = (cmap_frozen_slot_t *)(image + header.slots_offset);
+    memset(ctrl, _CM_CTRL_EMPTY, (size_t)capacity);
+
+    // Second pass, places every entry and copies its strings into the arena.
+    uint64_t arena_used = header.arena_offset;
+    const size_t group_mask = (size_t)capacity / _CMF_GROUP_WIDTH - 1;
+    for (_Bool ok = cmap_iter_start(map, &iter, &entry); ok; ok = cmap_iter_next(&iter, &entry)) {
+        const size_t hash = _cmap_frozen_hash(key_kind, entry.key);
+        size_t group = (hash >> 7) & group_mask;
+        uint32_t free_mask = _cmap_frozen_match(ctrl + group * _CMF_GROUP_WIDTH, _CM_CTRL_EMPTY);
+        for (size_t probe = 1; !free_mask; ++probe) {
+            group = (group + probe) & group_mask;
+            free_mask = _cmap_frozen_match(ctrl + group * _CMF_GROUP_WIDTH, _CM_CTRL_EMPTY);
+        }
+        const size_t slot = group * _CMF_GROUP_WIDTH + _cmap_ctz32(free_mask);
+        ctrl[slot] = (uint8_t)(hash & 0x7F);
+
+        const void *payloads[2] = {entry.key, entry.value};
+        const cmap_frozen_kind_t kinds[2] = {key_kind, val_kind};
+        uint64_t *fields[2] = {&slots[slot].key, &slots[slot].value};
+        _CMFOR(i, 0, 2, 1) {
+            if (kinds[i] == CMAP_FROZEN_INLINE) {
+                *fields[i] = (uint64_t)(uintptr_t)payloads[i];
+                continue;
+            }
+            const size_t len = strlen((const char *)payloads[i]) + 1;
+            memcpy(image + arena_used, payloads[i], len);
+            *fields[i] = arena_used;
+            arena_used += len;
+        }
+    }
+
+    const size_t path_len = strlen(path);
+    char *tmp_path = malloc(path_len + sizeof(".XXXXXX"));
+    _CMREQUIRE(tmp_path, free(image); return _CMFALSE);
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, ".XXXXXX", sizeof(".XXXXXX"));
+    const int fd = mkstemp(tmp_path);
+    _CMREQUIRE(fd >= 0, free(tmp_path); free(image); return _CMFALSE);
+    _Bool written = fchmod(fd, 0644) == 0; // mkstemp() creates the file private to its owner.
+    for (size_t done = 0; written && done < (size_t)header.file_size;) {
+        const ssize_t n = write(fd, image + done, (size_t)header.file_size - done);
+        written = n > 0;
+        done += written ? (size_t)n : 0;
+    }
+    free(image);
+    // Durable before the rename, so a crash never leaves a partial image at `path`.
+    written = written && fsync(fd) == 0;
+    written = close(fd) == 0 && written;
+    written = written && rename(tmp_path, path) == 0;
+    if (!written) {
+        unlink(tmp_path);
+    }
+    free(tmp_path);
+    return written;
+}
+
+// Maps a frozen image read-only and initializes a given pointer with it. Only the header is
+// validated, so opening is O(1) regardless of the image size.
+_CMSTCINL _Bool cmap_open_frozen(cmap_frozen_t **map, const char *path) {
+    _CMREQUIRE(map && path, return _CMFALSE);
+    const int fd = open(path, O_RDONLY);
+    _CMREQUIRE(fd >= 0, return _CMFALSE);
+    struct stat st;
+    _CMREQUIRE(fstat(fd, &st) == 0, close(fd); return _CMFALSE);
+    const size_t length = (size_t)st.st_size;
+    _CMREQUIRE(length >= sizeof(cmap_frozen_header_t), close(fd); return _CMFALSE);
+    void *base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file referenced.
+    _CMREQUIRE(base != MAP_FAILED, return _CMFALSE);
+
+    const cmap_frozen_header_t *header = (const cmap_frozen_header_t *)base;
+    const uint64_t capacity = header->capacity;
+    const _Bool valid =
+        memcmp(header->magic, _CMF_MAGIC, sizeof(header->magic)) == 0 &&
+        header->byte_order == _CMF_BYTE_ORDER && header->version == _CMF_VERSION &&
+        header->word_size == sizeof(size_t) && header->key_kind <= CMAP_FROZEN_CSTR &&
+        header->val_kind <= CMAP_FROZEN_CSTR && header->file_size == length &&
+        capacity % _CMF_GROUP_WIDTH == 0 && (capacity & (capacity - 1)) == 0 &&
+        capacity && capacity <= length && header->size < capacity &&
+        header->ctrl_offset <= length && header->ctrl_offset + capacity <= header->slots_offset &&
+        header->slots_offset <= length &&
+        header->slots_offset + capacity * sizeof(cmap_frozen_slot_t) <= header->arena_offset &&
+        header->arena_offset <= length && header->arena_offset + header->arena_size == length &&
+        (!header->arena_size || ((const uint8_t *)base)[length - 1] == '\0');
+    cmap_frozen_t *fmap = valid ? malloc(sizeof(cmap_frozen_t)) : NULL;
+    _CMREQUIRE(fmap, munmap(base, length); return _CMFALSE);
+    *fmap = (cmap_frozen_t){
+        ._base = (const uint8_t *)base,
+        ._length = length,
+        ._header = header,
+        ._ctrl = (const uint8_t *)base + header->ctrl_offset,
+        ._slots = (const cmap_frozen_slot_t *)((const uint8_t *)base + header->slots_offset),
+    };
+    *map = fmap;
+    return _CMTRUE;
+}
+
+// Unmaps a frozen image and uninitializes its pointer. Pointers returned by lookups become
+// invalid.
+_CMSTCINL void cmap_close_frozen(cmap_frozen_t **map) {
+    _CMREQUIRE(map && *map, return);
+    munmap((void *)(*map)->_base, (*map)->_length);
+    free(*map);
+    *map = NULL;
+}
+
+// Decodes a stored payload. CMAP_FROZEN_CSTR payloads resolve to a string inside the mapping.
+_CMSTCINL const void *
+_cmap_frozen_payload(const cmap_frozen_t *fmap, cmap_frozen_kind_t kind, uint64_t payload) {
+    if (kind == CMAP_FROZEN_INLINE) {
+        return (const void *)(uintptr_t)payload;
+    }
+    const cmap_frozen_header_t *header = fmap->_header;
+    _CMREQUIRE(payload >= header->arena_offset && payload < fmap->_length, return "");
+    return fmap->_base + payload;
+}
+
+// Gets the value of a key and assigns it to an out-parameter. Keys are passed as they were stored
+// in the source map: the payload itself, or a `const char *`.
+_CMSTCINL _Bool cmap_frozen_get(cmap_frozen_t **map, const void *key, const void **out) {
+    _CMREQUIRE(map && *map && out, return _CMFALSE);
+    const cmap_frozen_t *fmap = *map;
+    const cmap_frozen_kind_t key_kind = (cmap_frozen_kind_t)fmap->_header->key_kind;
+    const size_t hash = _cmap_frozen_hash(key_kind, key);
+    const size_t group_mask = (size_t)fmap->_header->capacity / _CMF_GROUP_WIDTH - 1;
+    const uint8_t tag = (uint8_t)(hash & 0x7F);
+    size_t group = (hash >> 7) & group_mask;
+    _CMFOR(probe, 1, group_mask + 2, 1) {
+        const uint8_t *ctrl = fmap->_ctrl + group * _CMF_GROUP_WIDTH;
+        uint32_t match = _cmap_frozen_match(ctrl, tag);
+        while (match) {
+            const cmap_frozen_slot_t *slot =
+                &fmap->_slots[group * _CMF_GROUP_WIDTH + _cmap_ctz32(match)];
+            const void *skey = _cmap_frozen_payload(fmap, key_kind, slot->key);
+            if (key_kind == CMAP_FROZEN_INLINE ? skey == key
+                                                : strcmp((const char *)skey, key) == 0) {
+                *out = _cmap_frozen_payload(
+                    fmap, (cmap_frozen_kind_t)fmap->_header->val_kind, slot->value
+                );
+                return _CMTRUE;
+            }
+            match &= match - 1;
+        }
+        if (_cmap_frozen_match(ctrl, _CM_CTRL_EMPTY)) {
+            return _CMFALSE;
+        }
+        group = (group + probe) & group_mask;
+    }
+    return _CMFALSE;
+}
+
+// Macro API accessors.
+#define CMAP_FROZEN_SIZE(map) ((size_t)map->_header->size)
+#define CMAP_FROZEN_CAPACITY(map) ((size_t)map->_header->capacity)
+
+// Macro API functions.
+#define CMAP_FREEZE(map, path, key_kind, val_kind) (cmap_freeze(&map, path, key_kind, val_kind))
+#define CMAP_OPEN_FROZEN(map, path) (cmap_open_frozen(&map, path))
+#define CMAP_CLOSE_FROZEN(map) (cmap_close_frozen(&map))
+#define CMAP_FROZEN_GETVAL(map, key, out)                                                          \
+    (cmap_frozen_get(&map, (const void *)key, (const void **)&out))
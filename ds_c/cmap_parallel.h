@@ -0,0 +1,721 @@
+/*  cmap_parallel.h
+ *  Multi-threaded bulk construction, traversal and merging of cmap.h maps.
+ *  Requires POSIX threads (e.g. -std=gnu11, or _POSIX_C_SOURCE >= 200112L with -std=c11).
+ *  Workers allocate through the map's allocator, which must then be thread-safe.
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+#include "cmap.h"
+
+#include <pthread.h>
+
+#define _CMP_MIN_CHUNK 4096         // Keys (or slots) per thread below which work stays serial.
+#define _CMP_MAX_THREADS 256
+#define _CMP_PARTITIONS_PER_THREAD 8 // Finer partitions even out the work of skewed ranges.
+
+// Implementation detail. A key being placed, with its hash computed once.
+typedef struct {
+    size_t hash;
+    void *key;
+    void *value;
+} _cmap_parallel_key_t;
+
+// Implementation detail. An entry of a merged source that was combined into an entry of the merged
+// map, so its key and value are destroyed once the merge succeeds.
+typedef struct {
+    cmap_t *source;
+    cmap_entry_t entry;
+} _cmap_merge_combined_t;
+
+// Implementation detail. The entries of a swiss or compact merge source, split by partition of the
+// merged bucket array. Partition `p` ends at `ends[p]` of `parted`.
+typedef struct {
+    _cmap_parallel_key_t *parted;
+    size_t *ends;
+} _cmap_merge_split_t;
+
+typedef enum {
+    _CMP_PHASE_COUNT = 0, // Hashes a range of keys and counts them per partition.
+    _CMP_PHASE_SCATTER,   // Copies a range of keys into their partitions, keeping their order.
+    _CMP_PHASE_PLACE,     // Inserts a range of partitioned keys. Their buckets belong to the task.
+    _CMP_PHASE_VISIT,     // Calls back for every entry of a range of buckets (or slots).
+    _CMP_PHASE_MERGE,     // Moves the entries of every source that fall into a range of buckets.
+    _CMP_PHASE_SPLIT_COUNT,   // Hashes a range of a merge source's slots, counting per partition.
+    _CMP_PHASE_SPLIT_SCATTER, // Copies a range of a merge source's entries into their partitions.
+} _cmap_parallel_phase_t;
+
+// Implementation detail. A contiguous range of work processed by a single thread.
+typedef struct {
+    cmap_t *map;
+    _cmap_parallel_phase_t phase;
+    size_t worker; // Index of the task, passed to callbacks.
+    size_t begin;
+    size_t end;
+    void *const *keys;
+    void *const *values;
+    size_t *hashes;
+    size_t *counts; // Keys per partition within the task's range, then their write offsets.
+    unsigned partition_shift;
+    _cmap_parallel_key_t *parted;
+    cpool_t *pool; // Overflow arrays allocated by the task, absorbed by the map afterwards.
+    size_t inserted;
+    _Bool ok;
+    void (*visit_func)(cmap_entry_t *, size_t, void *);
+    void (*combine_func)(void **, void *, void *);
+    void *ctx;
+    cmap_t *const *sources; // The previous storage of the merged map first, then the other maps.
+    size_t source_count;
+    _cmap_merge_split_t *splits; // Per source, if swiss and compact sources were split.
+    cmap_t *source;              // Source being split.
+    cmap_bucket_t *buckets;      // Bucket array being filled by a merge, of `capacity` buckets.
+    size_t capacity;             // Buckets being filled, by a build or a merge.
+    _cmap_merge_combined_t *combined; // Combined entries of sources with destructors.
+    size_t combined_count;
+    size_t combined_capacity;
+} _cmap_parallel_task_t;
+
+// Returns the partition of a hash. Partitions are contiguous ranges of the bucket array.
+_CMSTCINL size_t _cmap_parallel_partition(const _cmap_parallel_task_t *task, size_t hash) {
+    return (hash & (task->capacity - 1)) >> task->partition_shift;
+}
+
+// Returns the number of bits of a partition index for `ntasks` tasks over `capacity` buckets, a
+// power of two, and sets `shift` to the bits of a bucket index within its partition.
+_CMSTCINL unsigned _cmap_parallel_partition_bits(size_t capacity, size_t ntasks, unsigned *shift) {
+    unsigned capacity_bits = 0;
+    unsigned partition_bits = 0;
+    while (((size_t)1 << capacity_bits) < capacity) {
+        ++capacity_bits;
+    }
+    while (((size_t)1 << partition_bits) < ntasks * _CMP_PARTITIONS_PER_THREAD &&
+           partition_bits < capacity_bits) {
+        ++partition_bits;
+    }
+    *shift = capacity_bits - partition_bits;
+    return partition_bits;
+}
+
+// Calls back for every entry of a range of buckets, swiss slots or compact entries.
+_CMSTCINL void _cmap_parallel_visit(_cmap_parallel_task_t *task) {
+    cmap_t *cmap = task->map;
+    _CMFOR(i, task->begin, task->end, 1) {
+        if (cmap->_engine == CMAP_ENGINE_SWISS) {
+            if (!(cmap->_ctrl[i] & _CM_CTRL_EMPTY)) {
+                task->visit_func(&cmap->_slots[i], task->worker, task->ctx);
+            }
+            continue;
+        }
+        if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+            if (cmap->_entries[i].key != (void *)_CMSENTINEL) {
+                task->visit_func(&cmap->_entries[i], task->worker, task->ctx);
+            }
+            continue;
+        }
+        // Buckets past `_capacity` index into `_old_buckets`, as in cmap_iter_next().
+        cmap_bucket_t *bucket = i < cmap->_capacity
+                                    ? _CMBUCKET(cmap, cmap->_buckets, i)
+                                    : _CMBUCKET(cmap, cmap->_old_buckets, i - cmap->_capacity);
+        if (!bucket->_occupied) {
+            continue;
+        }
+        const size_t tbkt_capacity = bucket->_overflow_capacity + _CM_INLINE_SIZE;
+        _CMFOR(j, 0, tbkt_capacity, 1) {
+            cmap_entry_t *entry = _cmap_bucket_entry(bucket, j);
+            if (entry->key != (void *)_CMSENTINEL) {
+                task->visit_func(entry, task->worker, task->ctx);
+            }
+        }
+    }
+}
+
+// Records a source entry that was combined, should the source destroy its entries.
+_CMSTCINL void _cmap_merge_record(_cmap_parallel_task_t *task, cmap_t *src, cmap_entry_t *entry) {
+    if (!src->_key_destructor && !src->_val_destructor) {
+        return;
+    }
+    if (task->combined_count == task->combined_capacity) {
+        const size_t ncapacity = task->combined_capacity ? task->combined_capacity * 2 : 16;
+        _cmap_merge_combined_t *combined = NULL;
+        if (ncapacity < SIZE_MAX / sizeof(_cmap_merge_combined_t)) {
+            combined = realloc(task->combined, ncapacity * sizeof(_cmap_merge_combined_t));
+        }
+        _CMREQUIRE(combined, task->ok = _CMFALSE; return);
+        task->combined = combined;
+        task->combined_capacity = ncapacity;
+    }
+    task->combined[task->combined_count++] =
+        (_cmap_merge_combined_t){.source = src, .entry = *entry};
+}
+
+// Moves an entry of a source into a bucket of the merged bucket array, combining it with an entry
+// already moved there. Entries of the merged map's own storage (`own`) are distinct.
+_CMSTCINL void _cmap_merge_entry(
+    _cmap_parallel_task_t *task,
+    cmap_t *src,
+    _Bool own,
+    cmap_entry_t *entry,
+    size_t idx,
+    size_t hash
+) {
+    if (!task->ok) {
+        return;
+    }
+    cmap_t *cmap = task->map;
+    cmap_bucket_t *bucket = _CMBUCKET(cmap, task->buckets, idx);
+    size_t probes = 0;
+    cmap_entry_t *kept = own ? NULL : _cmap_bucket_scan(cmap, bucket, entry->key, hash, &probes);
+    if (kept) {
+        task->combine_func(&kept->value, entry->value, task->ctx);
+        _cmap_merge_record(task, src, entry);
+        return;
+    }
+    task->ok = _cmap_bucket_place_in(cmap, bucket, &task->pool, entry->key, entry->value, hash);
+    task->inserted += task->ok;
+}
+
+// Moves the entries of a source bucket that fall into the task's range. `idx` is the merged bucket
+// every entry lands in, or SIZE_MAX if it has to be derived from each entry's hash.
+_CMSTCINL void _cmap_merge_bucket(
+    _cmap_parallel_task_t *task, cmap_t *src, cmap_bucket_t *bucket, _Bool own, size_t idx
+) {
+    if (!bucket->_occupied) {
+        return;
+    }
+    const _Bool cached = task->map->_flags & CMAP_FLAG_CACHED_HASH;
+    const size_t tbkt_capacity = bucket->_overflow_capacity + _CM_INLINE_SIZE;
+    _CMFOR(j, 0, tbkt_capacity, 1) {
+        cmap_entry_t *entry = _cmap_bucket_entry(bucket, j);
+        if (entry->key == (void *)_CMSENTINEL) {
+            continue;
+        }
+        const size_t hash = idx == SIZE_MAX || cached ? _cmap_bucket_hash(src, bucket, j) : 0;
+        const size_t target = idx == SIZE_MAX ? hash & (task->capacity - 1) : idx;
+        if (target >= task->begin && target < task->end) {
+            _cmap_merge_entry(task, src, own, entry, target, hash);
+        }
+    }
+}
+
+/*
+    Moves the entries of a source that fall into the task's range of merged buckets. Bucket `s` of
+    a bucket-engine source that is at least as large as the merged array only holds entries of
+    merged bucket `s & (capacity - 1)`, so they move without being rehashed (unless hashes are
+    cached, which are then read back). Smaller sources are filtered by hash, as are the other
+    engines when they were not split.
+*/
+_CMSTCINL void _cmap_merge_source(_cmap_parallel_task_t *task, cmap_t *src, _Bool own) {
+    const size_t mask = task->capacity - 1;
+    if (src->_engine == CMAP_ENGINE_BUCKET && src->_capacity >= task->capacity) {
+        _CMFOR(idx, task->begin, task->end, 1) {
+            _CMFOR(s, idx, src->_capacity, task->capacity) {
+                _cmap_merge_bucket(task, src, _CMBUCKET(src, src->_buckets, s), own, idx);
+            }
+        }
+    } else if (src->_engine == CMAP_ENGINE_BUCKET) {
+        // Merged bucket `idx` only draws from source bucket `idx & (src->_capacity - 1)`.
+        const size_t count = _CMMIN(task->end - task->begin, src->_capacity);
+        _CMFOR(k, 0, count, 1) {
+            const size_t s = (task->begin + k) & (src->_capacity - 1);
+            _cmap_merge_bucket(task, src, _CMBUCKET(src, src->_buckets, s), own, SIZE_MAX);
+        }
+    } else if (src->_engine == CMAP_ENGINE_SWISS) {
+        _CMFOR(i, 0, src->_capacity, 1) {
+            if (src->_ctrl[i] & _CM_CTRL_EMPTY) {
+                continue;
+            }
+            cmap_entry_t *entry = &src->_slots[i];
+            const size_t hash = src->_hashes ? src->_hashes[i] : src->_hash_func(entry->key);
+            if ((hash & mask) >= task->begin && (hash & mask) < task->end) {
+                _cmap_merge_entry(task, src, own, entry, hash & mask, hash);
+            }
+        }
+    } else {
+        _CMFOR(i, 0, src->_used, 1) {
+            const size_t hash = src->_hashes[i];
+            if (src->_entries[i].key != (void *)_CMSENTINEL && (hash & mask) >= task->begin &&
+                (hash & mask) < task->end) {
+                _cmap_merge_entry(task, src, own, &src->_entries[i], hash & mask, hash);
+            }
+        }
+    }
+}
+
+// Moves the entries of a split source that fall into the task's range of merged buckets, which
+// spans whole partitions.
+_CMSTCINL void _cmap_merge_split_source(
+    _cmap_parallel_task_t *task, cmap_t *src, const _cmap_merge_split_t *split
+) {
+    const size_t first = task->begin >> task->partition_shift;
+    const size_t last = task->end >> task->partition_shift;
+    const size_t end = split->ends[last - 1];
+    for (size_t k = first ? split->ends[first - 1] : 0; k < end && task->ok; ++k) {
+        const _cmap_parallel_key_t *key = &split->parted[k];
+        cmap_entry_t entry = {.key = key->key, .value = key->value};
+        _cmap_merge_entry(task, src, _CMFALSE, &entry, key->hash & (task->capacity - 1), key->hash);
+    }
+}
+
+// Returns the entry in slot `i` of a swiss or compact source, or `NULL` if the slot is empty.
+_CMSTCINL cmap_entry_t *_cmap_merge_slot(cmap_t *src, size_t i) {
+    if (src->_engine == CMAP_ENGINE_SWISS) {
+        return src->_ctrl[i] & _CM_CTRL_EMPTY ? NULL : &src->_slots[i];
+    }
+    return src->_entries[i].key == (void *)_CMSENTINEL ? NULL : &src->_entries[i];
+}
+
+// Runs one phase over the range of a task.
+_CMSTCINL void *_cmap_parallel_worker(void *arg) {
+    _cmap_parallel_task_t *task = (_cmap_parallel_task_t *)arg;
+    cmap_t *cmap = task->map;
+    if (task->phase == _CMP_PHASE_COUNT) {
+        _cmap_hash_batch(
+            cmap, task->keys + task->begin, task->end - task->begin, task->hashes + task->begin
+        );
+        _CMFOR(i, task->begin, task->end, 1) {
+            ++task->counts[_cmap_parallel_partition(task, task->hashes[i])];
+        }
+    } else if (task->phase == _CMP_PHASE_SCATTER) {
+        _CMFOR(i, task->begin, task->end, 1) {
+            const size_t hash = task->hashes[i];
+            const size_t slot = task->counts[_cmap_parallel_partition(task, hash)]++;
+            task->parted[slot] = (_cmap_parallel_key_t){
+                .hash = hash, .key = task->keys[i], .value = task->values[i]
+            };
+        }
+    } else if (task->phase == _CMP_PHASE_PLACE) {
+        for (size_t i = task->begin; i < task->end && task->ok; ++i) {
+            const _cmap_parallel_key_t *key = &task->parted[i];
+            cmap_entry_t *entry = _cmap_bucket_find(cmap, key->key, key->hash, NULL);
+            if (entry) {
+                entry->value = key->value;
+                continue;
+            }
+            const size_t idx = key->hash & (cmap->_capacity - 1);
+            cmap_bucket_t *bucket = _CMBUCKET(cmap, cmap->_buckets, idx);
+            task->ok =
+                _cmap_bucket_place_in(cmap, bucket, &task->pool, key->key, key->value, key->hash);
+            task->inserted += task->ok;
+        }
+    } else if (task->phase == _CMP_PHASE_MERGE) {
+        _CMFOR(i, 0, task->source_count, 1) {
+            if (task->splits && task->splits[i].parted) {
+                _cmap_merge_split_source(task, task->sources[i], &task->splits[i]);
+            } else {
+                _cmap_merge_source(task, task->sources[i], i == 0);
+            }
+        }
+    } else if (task->phase == _CMP_PHASE_SPLIT_COUNT) {
+        // Hashes not cached by the source are computed here only, and kept for the scatter.
+        cmap_t *src = task->source;
+        _CMFOR(i, task->begin, task->end, 1) {
+            cmap_entry_t *entry = _cmap_merge_slot(src, i);
+            if (entry) {
+                const size_t hash = src->_hashes ? src->_hashes[i]
+                                                 : (task->hashes[i] = src->_hash_func(entry->key));
+                ++task->counts[_cmap_parallel_partition(task, hash)];
+            }
+        }
+    } else if (task->phase == _CMP_PHASE_SPLIT_SCATTER) {
+        cmap_t *src = task->source;
+        _CMFOR(i, task->begin, task->end, 1) {
+            cmap_entry_t *entry = _cmap_merge_slot(src, i);
+            if (entry) {
+                const size_t hash = src->_hashes ? src->_hashes[i] : task->hashes[i];
+                const size_t slot = task->counts[_cmap_parallel_partition(task, hash)]++;
+                task->parted[slot] =
+                    (_cmap_parallel_key_t){.hash = hash, .key = entry->key, .value = entry->value};
+            }
+        }
+    } else {
+        _cmap_parallel_visit(task);
+    }
+    return NULL;
+}
+
+// Runs every task on its own thread. The calling thread runs the first task, along with any task
+// whose thread could not be started.
+_CMSTCINL void _cmap_parallel_run(_cmap_parallel_task_t *tasks, size_t ntasks) {
+    pthread_t threads[_CMP_MAX_THREADS];
+    _Bool started[_CMP_MAX_THREADS] = {0};
+    _CMFOR(i, 1, ntasks, 1) {
+        started[i] = pthread_create(&threads[i], NULL, _cmap_parallel_worker, &tasks[i]) == 0;
+    }
+    _CMFOR(i, 0, ntasks, 1) {
+        if (!started[i]) {
+            _cmap_parallel_worker(&tasks[i]);
+        }
+    }
+    _CMFOR(i, 1, ntasks, 1) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+// Swaps the storage of an empty bucket-engine map for a fresh bucket array of `capacity` buckets,
+// so that every overflow array is allocated by the task owning its bucket.
+_CMSTCINL _Bool _cmap_parallel_reset(cmap_t *cmap, size_t capacity) {
+    _CMREQUIRE(_cmap_migrate(cmap, SIZE_MAX), return _CMFALSE);
+    cmap_bucket_t *buckets = _cmap_bucket_alloc(cmap, capacity);
+    _CMREQUIRE(buckets, return _CMFALSE);
+    _cmap_bucket_free(cmap, cmap->_buckets, cmap->_capacity);
+    cpool_reset(&cmap->_pool);
+    cmap->_buckets = buckets;
+    cmap->_capacity = capacity;
+    return _CMTRUE;
+}
+
+// Turns the per-partition counts of tasks into write offsets. Partitions are laid out in order, and
+// within one partition, the keys of earlier tasks come first.
+_CMSTCINL void
+_cmap_parallel_offsets(_cmap_parallel_task_t *tasks, size_t ntasks, size_t npartitions) {
+    size_t offset = 0;
+    _CMFOR(p, 0, npartitions, 1) {
+        _CMFOR(i, 0, ntasks, 1) {
+            const size_t count = tasks[i].counts[p];
+            tasks[i].counts[p] = offset;
+            offset += count;
+        }
+    }
+}
+
+// Partitions hashed keys by bucket range, then inserts every partition on its own task.
+_CMSTCINL _Bool _cmap_build_parallel(
+    cmap_t *cmap,
+    void *const *keys,
+    void *const *values,
+    size_t n,
+    _cmap_parallel_task_t *tasks,
+    size_t ntasks
+) {
+    unsigned partition_shift = 0;
+    const unsigned partition_bits =
+        _cmap_parallel_partition_bits(cmap->_capacity, ntasks, &partition_shift);
+    const size_t npartitions = (size_t)1 << partition_bits;
+    size_t *hashes = malloc(n * sizeof(size_t));
+    size_t *counts = calloc(ntasks * npartitions, sizeof(size_t));
+    _cmap_parallel_key_t *parted = malloc(n * sizeof(_cmap_parallel_key_t));
+    _Bool ok = hashes && counts && parted;
+    _CMFOR(i, 0, ntasks, 1) {
+        tasks[i] = (_cmap_parallel_task_t){
+            .map = cmap,
+            .phase = _CMP_PHASE_COUNT,
+            .worker = i,
+            .begin = n * i / ntasks,
+            .end = n * (i + 1) / ntasks,
+            .keys = keys,
+            .values = values,
+            .hashes = hashes,
+            .counts = counts + i * npartitions,
+            .partition_shift = partition_shift,
+            .parted = parted,
+            .capacity = cmap->_capacity,
+            .ok = _CMTRUE,
+        };
+        ok = ok && cpool_init_with(&tasks[i].pool, cmap->_allocator);
+    }
+    if (ok) {
+        _cmap_parallel_run(tasks, ntasks);
+        _cmap_parallel_offsets(tasks, ntasks, npartitions); // Later duplicates still win.
+        _CMFOR(i, 0, ntasks, 1) { tasks[i].phase = _CMP_PHASE_SCATTER; }
+        _cmap_parallel_run(tasks, ntasks);
+
+        // After scattering, the offsets of the last task mark the end of every partition.
+        _CMFOR(i, 0, ntasks, 1) {
+            const size_t first = npartitions * i / ntasks;
+            const size_t last = npartitions * (i + 1) / ntasks;
+            tasks[i].phase = _CMP_PHASE_PLACE;
+            tasks[i].begin = first ? tasks[ntasks - 1].counts[first - 1] : 0;
+            tasks[i].end = last ? tasks[ntasks - 1].counts[last - 1] : 0;
+        }
+        _cmap_parallel_run(tasks, ntasks);
+    }
+    _CMFOR(i, 0, ntasks, 1) {
+        ok = ok && tasks[i].ok;
+        cmap->_size += tasks[i].inserted;
+        if (tasks[i].pool) {
+            cpool_absorb(&cmap->_pool, &tasks[i].pool);
+        }
+    }
+    _cmap_filter_rebuild(cmap); // Tasks never touch the filter, which every task would share.
+    free(hashes);
+    free(counts);
+    free(parted);
+    return ok;
+}
+
+/*
+    Inserts `n` key-value pairs into an empty map using up to `threads` threads (0 picks one). If a
+    key occurs more than once, its last value wins, as with cmap_insert_batch(). Keys are hashed
+    and partitioned by bucket range first, so every thread then fills disjoint buckets without
+    locking. Maps that are not empty or not CMAP_ENGINE_BUCKET are filled by cmap_insert_batch().
+    A failed allocation may leave some of the pairs inserted.
+*/
+_CMSTCINL _Bool cmap_build_parallel(
+    cmap_t **map, void *const *keys, void *const *values, size_t n, size_t threads
+) {
+    _CMREQUIRE(map && *map && (keys || !n) && (values || !n), return _CMFALSE);
+    cmap_t *cmap = *map;
+    threads = _CMMIN(_CMMAX(threads, 1), _CMP_MAX_THREADS);
+    const size_t ntasks = _CMMIN(threads, _CMMAX(n / _CMP_MIN_CHUNK, 1));
+    if (cmap->_engine != CMAP_ENGINE_BUCKET || cmap->_size || ntasks == 1) {
+        return cmap_insert_batch(map, keys, values, n);
+    }
+    _CMREQUIRE(n < SIZE_MAX / 2 / sizeof(_cmap_parallel_key_t), return _CMFALSE);
+    const size_t capacity = _CMMAX(_cmap_fit_capacity(cmap, n), cmap->_capacity);
+    _CMREQUIRE(_cmap_parallel_reset(cmap, capacity), return _CMFALSE);
+    _cmap_parallel_task_t tasks[_CMP_MAX_THREADS];
+    return _cmap_build_parallel(cmap, keys, values, n, tasks, ntasks);
+}
+
+/*
+    Calls `visit_func` for every entry of a map, splitting its buckets (or slots) into ranges that
+    run on up to `threads` threads (0 picks one). The callback receives the entry, the index of
+    the thread running it (below `threads`, e.g. to pick per-thread state) and `ctx`. It may
+    update the value of the entry, but must not change its key or modify the map.
+*/
+_CMSTCINL _Bool cmap_for_each_parallel(
+    cmap_t **map,
+    void (*visit_func)(cmap_entry_t *entry, size_t worker, void *ctx),
+    void *ctx,
+    size_t threads
+) {
+    _CMREQUIRE(map && *map && visit_func, return _CMFALSE);
+    cmap_t *cmap = *map;
+    size_t units = cmap->_capacity + cmap->_old_capacity;
+    if (cmap->_engine == CMAP_ENGINE_COMPACT) {
+        units = cmap->_used;
+    }
+    threads = _CMMIN(_CMMAX(threads, 1), _CMP_MAX_THREADS);
+    const size_t ntasks = _CMMIN(threads, _CMMAX(units / _CMP_MIN_CHUNK, 1));
+    _cmap_parallel_task_t tasks[_CMP_MAX_THREADS];
+    _CMFOR(i, 0, ntasks, 1) {
+        tasks[i] = (_cmap_parallel_task_t){
+            .map = cmap,
+            .phase = _CMP_PHASE_VISIT,
+            .worker = i,
+            .begin = units * i / ntasks,
+            .end = units * (i + 1) / ntasks,
+            .visit_func = visit_func,
+            .ctx = ctx,
+        };
+    }
+    _cmap_parallel_run(tasks, ntasks);
+    return _CMTRUE;
+}
+
+// Destroys the key and value of every source entry a merge task combined into the merged map.
+_CMSTCINL void _cmap_merge_release(_cmap_parallel_task_t *task) {
+    _CMFOR(i, 0, task->combined_count, 1) {
+        _cmap_uninit_entry(&task->combined[i].entry, task->combined[i].source);
+    }
+    free(task->combined);
+}
+
+/*
+    Splits the entries of a swiss or compact merge source by partition of the merged bucket array,
+    on up to `ntasks` of `tasks`, so that every merge task only walks its own partitions instead
+    of the whole source. Each entry is hashed at most once. The source is left untouched.
+*/
+_CMSTCINL _Bool _cmap_merge_split(
+    _cmap_merge_split_t *split,
+    cmap_t *src,
+    size_t capacity,
+    unsigned partition_bits,
+    unsigned partition_shift,
+    _cmap_parallel_task_t *tasks,
+    size_t ntasks
+) {
+    const size_t units = src->_engine == CMAP_ENGINE_SWISS ? src->_capacity : src->_used;
+    const size_t npartitions = (size_t)1 << partition_bits;
+    ntasks = _CMMIN(ntasks, _CMMAX(units / _CMP_MIN_CHUNK, 1));
+    size_t *hashes = src->_hashes ? NULL : malloc(_CMMAX(units, 1) * sizeof(size_t));
+    split->ends = calloc(ntasks * npartitions, sizeof(size_t));
+    split->parted = malloc(_CMMAX(src->_size, 1) * sizeof(_cmap_parallel_key_t));
+    if ((!src->_hashes && !hashes) || !split->ends || !split->parted) {
+        free(hashes);
+        return _CMFALSE;
+    }
+    _CMFOR(i, 0, ntasks, 1) {
+        tasks[i] = (_cmap_parallel_task_t){
+            .phase = _CMP_PHASE_SPLIT_COUNT,
+            .begin = units * i / ntasks,
+            .end = units * (i + 1) / ntasks,
+            .hashes = hashes,
+            .counts = split->ends + i * npartitions,
+            .partition_shift = partition_shift,
+            .parted = split->parted,
+            .source = src,
+            .capacity = capacity,
+        };
+    }
+    _cmap_parallel_run(tasks, ntasks);
+    _cmap_parallel_offsets(tasks, ntasks, npartitions); // Keeps the order of the source's slots.
+    _CMFOR(i, 0, ntasks, 1) { tasks[i].phase = _CMP_PHASE_SPLIT_SCATTER; }
+    _cmap_parallel_run(tasks, ntasks);
+
+    // After scattering, the offsets of the last task mark the end of every partition.
+    memmove(split->ends, tasks[ntasks - 1].counts, npartitions * sizeof(size_t));
+    free(hashes);
+    return _CMTRUE;
+}
+
+// Releases the splits of `count` merge sources.
+_CMSTCINL void _cmap_merge_split_free(_cmap_merge_split_t *splits, size_t count) {
+    _CMREQUIRE(splits, return);
+    _CMFOR(i, 0, count, 1) {
+        free(splits[i].parted);
+        free(splits[i].ends);
+    }
+    free(splits);
+}
+
+/*
+    Moves every entry of `n` maps into `dst`, leaving them empty. A key that is already present is
+    combined through `combine_func(&dst_value, src_value, ctx)`, which must leave `src_value`
+    intact: the source's key and value are destroyed afterwards with the source's destructors.
+    `dst` must be CMAP_ENGINE_BUCKET, and every map must share its hash and comparison functions.
+
+    The entries are moved into a new bucket array of `dst`, at least as large as the largest one
+    involved and large enough for disjoint keys. Its buckets are split into ranges moved on up to
+    `threads` threads (0 picks one), each owning its buckets, so no locking is needed. Bucket-engine
+    sources at least as large as the new array move without being rehashed. With several threads,
+    swiss and compact sources are first split by bucket range, hashing every entry at most once.
+
+    On failure, returns `false` and leaves every map as it was, apart from what `combine_func` did
+    to the values pointed to.
+*/
+_CMSTCINL _Bool cmap_merge_n(
+    cmap_t **dst,
+    cmap_t **srcs,
+    size_t n,
+    void (*combine_func)(void **dst_value, void *src_value, void *ctx),
+    void *ctx,
+    size_t threads
+) {
+    _CMREQUIRE(dst && *dst && (srcs || !n) && combine_func, return _CMFALSE);
+    _CMREQUIRE(n < SIZE_MAX / sizeof(cmap_t *) - 1, return _CMFALSE);
+    cmap_t *cmap = *dst;
+    _CMREQUIRE(cmap->_engine == CMAP_ENGINE_BUCKET, return _CMFALSE);
+    _CMREQUIRE(_cmap_migrate(cmap, SIZE_MAX), return _CMFALSE);
+    size_t capacity = cmap->_capacity;
+    size_t total = cmap->_size; // Upper bound of the merged size.
+    _CMFOR(i, 0, n, 1) {
+        cmap_t *src = srcs[i];
+        _CMREQUIRE(src && src != cmap, return _CMFALSE);
+        _CMREQUIRE(
+            src->_hash_func == cmap->_hash_func && src->_comparison_func == cmap->_comparison_func,
+            return _CMFALSE
+        );
+        _CMREQUIRE(_cmap_migrate(src, SIZE_MAX), return _CMFALSE);
+        if (src->_engine == CMAP_ENGINE_BUCKET) {
+            capacity = _CMMAX(capacity, src->_capacity);
+        }
+        total = total > SIZE_MAX - src->_size ? SIZE_MAX : total + src->_size;
+    }
+    _CMREQUIRE(n, return _CMTRUE);
+    if (total >= capacity * cmap->_max_load) {
+        // Sized for disjoint keys up front, as rehashing afterwards would move every entry again.
+        capacity = _cmap_fit_capacity(cmap, total);
+    }
+    cmap_t **sources = malloc((n + 1) * sizeof(cmap_t *));
+    cmap_bucket_t *buckets = _cmap_bucket_alloc(cmap, capacity);
+    _Bool ok = sources && buckets;
+    if (sources) {
+        sources[0] = cmap;
+        memcpy(sources + 1, srcs, n * sizeof(cmap_t *));
+    }
+    threads = _CMMIN(_CMMAX(threads, 1), _CMP_MAX_THREADS);
+    const size_t ntasks = _CMMIN(threads, _CMMAX(capacity / _CMP_MIN_CHUNK, 1));
+    _cmap_parallel_task_t tasks[_CMP_MAX_THREADS];
+    unsigned partition_shift = 0;
+    const unsigned partition_bits =
+        _cmap_parallel_partition_bits(capacity, ntasks, &partition_shift);
+    const size_t npartitions = (size_t)1 << partition_bits;
+
+    // A single task walks every source once anyway, so sources are only split for several.
+    _cmap_merge_split_t *splits = ntasks > 1 ? calloc(n + 1, sizeof(_cmap_merge_split_t)) : NULL;
+    ok = ok && (ntasks == 1 || splits);
+    _CMFOR(i, 1, n + 1, 1) {
+        if (ok && splits && srcs[i - 1]->_engine != CMAP_ENGINE_BUCKET) {
+            ok = _cmap_merge_split(
+                &splits[i], srcs[i - 1], capacity, partition_bits, partition_shift, tasks, ntasks
+            );
+        }
+    }
+    _CMFOR(i, 0, ntasks, 1) {
+        tasks[i] = (_cmap_parallel_task_t){
+            .map = cmap,
+            .phase = _CMP_PHASE_MERGE,
+            .worker = i,
+            .begin = (npartitions * i / ntasks) << partition_shift,
+            .end = (npartitions * (i + 1) / ntasks) << partition_shift,
+            .partition_shift = partition_shift,
+            .ok = _CMTRUE,
+            .combine_func = combine_func,
+            .ctx = ctx,
+            .sources = sources,
+            .source_count = n + 1,
+            .splits = splits,
+            .buckets = buckets,
+            .capacity = capacity,
+        };
+        ok = ok && cpool_init_with(&tasks[i].pool, cmap->_allocator);
+    }
+    if (ok) {
+        _cmap_parallel_run(tasks, ntasks);
+    }
+    size_t size = 0;
+    _CMFOR(i, 0, ntasks, 1) {
+        ok = ok && tasks[i].ok;
+        size += tasks[i].inserted;
+        if (i > 0 && tasks[i].pool && tasks[0].pool) {
+            cpool_absorb(&tasks[0].pool, &tasks[i].pool);
+        }
+    }
+    free(sources);
+    _cmap_merge_split_free(splits, n + 1);
+    if (!ok) {
+        // The entries are still owned by their previous storage, so only new storage is released.
+        _cmap_bucket_free(cmap, buckets, capacity);
+        _CMFOR(i, 0, ntasks, 1) {
+            cpool_uninit(&tasks[i].pool);
+            free(tasks[i].combined);
+        }
+        return _CMFALSE;
+    }
+    _cmap_bucket_free(cmap, cmap->_buckets, cmap->_capacity);
+    cpool_uninit(&cmap->_pool);
+    cmap->_buckets = buckets;
+    cmap->_capacity = capacity;
+    cmap->_pool = tasks[0].pool;
+    cmap->_size = size;
+    _cmap_filter_rebuild(cmap);
+    _CMFOR(i, 0, ntasks, 1) { _cmap_merge_release(&tasks[i]); }
+    _CMFOR(i, 0, n, 1) { _cmap_forget(srcs[i]); }
+    return _CMTRUE;
+}
+
+// Moves every entry of `src` into `dst`. See cmap_merge_n().
+_CMSTCINL _Bool cmap_merge(
+    cmap_t **dst,
+    cmap_t **src,
+    void (*combine_func)(void **dst_value, void *src_value, void *ctx),
+    void *ctx,
+    size_t threads
+) {
+    _CMREQUIRE(src && *src, return _CMFALSE);
+    return cmap_merge_n(dst, src, 1, combine_func, ctx, threads);
+}
+
+// Macro API functions.
+#define CMAP_BUILD_PARALLEL(map, keys, values, n, threads)                                         \
+    (cmap_build_parallel(&map, (void *const *)keys, (void *const *)values, n, threads))
+#define CMAP_FOR_EACH_PARALLEL(map, visit_func, ctx, threads)                                      \
+    (cmap_for_each_parallel(&map, visit_func, (void *)ctx, threads))
+#define CMAP_MERGE(dst, src, combine_func, ctx, threads)                                           \
+    (cmap_merge(&dst, &src, combine_func, (void *)ctx, threads))
+#define CMAP_MERGE_N(dst, srcs, n, combine_func, ctx, threads)                                     \
+    (cmap_merge_n(&dst, srcs, n, combine_func, (void *)ctx, threads))
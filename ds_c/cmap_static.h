@@ -0,0 +1,353 @@
+/*  cmap_static.h
+ *  A static, read-only hashmap backed by a BBHash-style minimal perfect hash function.
+ *  Requires POSIX threads (e.g. -std=gnu11, or _POSIX_C_SOURCE >= 200112L with -std=c11).
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+#include "cmap.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define _CMS_GAMMA 2.0       // Level bits per remaining key. Trades memory for fewer levels.
+#define _CMS_MAX_LEVELS 24   // Keys still colliding after the last level go to a fallback cmap.
+#define _CMS_RANK_WORDS 8    // A cumulative rank is stored every 512 bits.
+#define _CMS_MIN_CHUNK 4096  // Keys per thread below which construction stays single-threaded.
+#define _CMS_MAX_THREADS 256
+
+/*
+    The minimal perfect hash maps every key onto exactly one slot of `_slots` through a cascade
+    of levels. A key lands on the first level where its position is not shared with any other
+    key of that level, and its slot is the rank of that position across all levels.
+*/
+typedef struct {
+    uint64_t *_bits;  // Level bit arrays, concatenated.
+    uint64_t *_ranks; // Set bits before each block of _CMS_RANK_WORDS words.
+    size_t _level_count;
+    size_t _level_offsets[_CMS_MAX_LEVELS + 1]; // Bit offset of each level in `_bits`.
+    cmap_entry_t *_slots;
+    size_t _slot_count;
+    size_t _size;
+    cmap_t *_fallback; // `NULL` unless some keys never resolved.
+    size_t (*_hash_func)(const void *);
+    int (*_comparison_func)(const void *, const void *);
+} cmap_static_t;
+
+// Implementation detail. A key being placed, with its hash computed once.
+typedef struct {
+    size_t hash;
+    void *key;
+    void *value;
+} _cmap_static_key_t;
+
+typedef enum {
+    _CMS_PHASE_MARK = 0, // Marks the level positions of every key, recording collisions.
+    _CMS_PHASE_FILTER,   // Compacts the keys that collided, for the next level.
+    _CMS_PHASE_PLACE,    // Writes every resolved key into its slot.
+} _cmap_static_phase_t;
+
+// Implementation detail. A contiguous range of keys processed by a single thread.
+typedef struct {
+    cmap_static_t *map;
+    _cmap_static_phase_t phase;
+    _cmap_static_key_t *keys;
+    size_t begin;
+    size_t end;
+    size_t survivors;
+    size_t level;
+    _Atomic uint64_t *seen;
+    _Atomic uint64_t *collided;
+} _cmap_static_task_t;
+
+_CMSTCINL unsigned _cmap_popcount64(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_popcountll(word);
+#else
+    unsigned n = 0;
+    for (; word; word &= word - 1) {
+        ++n;
+    }
+    return n;
+#endif
+}
+
+// Returns the position of a hash within a level of `nbits` bits.
+_CMSTCINL size_t _cmap_static_pos(size_t hash, size_t level, size_t nbits) {
+    const size_t seed = (level + 1) * (size_t)0x9E3779B97F4A7C15ULL;
+    return cmap_genhash((void *)(hash ^ seed)) % nbits;
+}
+
+// Returns the slot of a hash, or SIZE_MAX if it did not resolve on any level.
+_CMSTCINL size_t _cmap_static_slot(const cmap_static_t *smap, size_t hash) {
+    _CMFOR(level, 0, smap->_level_count, 1) {
+        const size_t offset = smap->_level_offsets[level];
+        const size_t pos =
+            offset + _cmap_static_pos(hash, level, smap->_level_offsets[level + 1] - offset);
+        const size_t word = pos / 64;
+        const uint64_t bit = (uint64_t)1 << (pos % 64);
+        if (!(smap->_bits[word] & bit)) {
+            continue;
+        }
+        size_t rank = (size_t)smap->_ranks[word / _CMS_RANK_WORDS];
+        _CMFOR(i, word - word % _CMS_RANK_WORDS, word, 1) {
+            rank += _cmap_popcount64(smap->_bits[i]);
+        }
+        return rank + _cmap_popcount64(smap->_bits[word] & (bit - 1));
+    }
+    return SIZE_MAX;
+}
+
+// Runs one construction phase over a range of keys.
+_CMSTCINL void *_cmap_static_worker(void *arg) {
+    _cmap_static_task_t *task = (_cmap_static_task_t *)arg;
+    cmap_static_t *smap = task->map;
+    const size_t level = task->level;
+    const size_t offset = smap->_level_offsets[level];
+    const size_t nbits = smap->_level_offsets[level + 1] - offset;
+    size_t survivors = task->begin;
+    _CMFOR(i, task->begin, task->end, 1) {
+        _cmap_static_key_t *key = &task->keys[i];
+        if (task->phase == _CMS_PHASE_PLACE) {
+            const size_t slot = _cmap_static_slot(smap, key->hash);
+            if (slot != SIZE_MAX) {
+                smap->_slots[slot] = (cmap_entry_t){.key = key->key, .value = key->value};
+            }
+            continue;
+        }
+        const size_t pos = _cmap_static_pos(key->hash, level, nbits);
+        const uint64_t bit = (uint64_t)1 << (pos % 64);
+        if (task->phase == _CMS_PHASE_MARK) {
+            const uint64_t prv =
+                atomic_fetch_or_explicit(&task->seen[pos / 64], bit, memory_order_relaxed);
+            if (prv & bit) {
+                atomic_fetch_or_explicit(&task->collided[pos / 64], bit, memory_order_relaxed);
+            }
+        } else if (atomic_load_explicit(&task->collided[pos / 64], memory_order_relaxed) & bit) {
+            task->keys[survivors++] = *key;
+        }
+    }
+    task->survivors = survivors - task->begin;
+    return NULL;
+}
+
+// Splits `n` keys into one task per thread and runs a phase over them. The calling thread
+// processes the first range itself.
+_CMSTCINL _Bool
+_cmap_static_run(_cmap_static_task_t *tasks, size_t ntasks, _cmap_static_task_t base, size_t n) {
+    pthread_t threads[_CMS_MAX_THREADS];
+    size_t spawned = 0;
+    _Bool ok = _CMTRUE;
+    _CMFOR(i, 0, ntasks, 1) {
+        tasks[i] = base;
+        tasks[i].begin = n * i / ntasks;
+        tasks[i].end = n * (i + 1) / ntasks;
+    }
+    for (size_t i = 1; i < ntasks && ok; ++i, ++spawned) {
+        ok = pthread_create(&threads[i], NULL, _cmap_static_worker, &tasks[i]) == 0;
+    }
+    if (!ok) {
+        --spawned; // The failed thread was never started.
+    }
+    _cmap_static_worker(&tasks[0]);
+    _CMFOR(i, 0, spawned, 1) { pthread_join(threads[i + 1], NULL); }
+    return ok;
+}
+
+// Builds the levels, rank table and slots of a map from an array of hashed keys.
+_CMSTCINL _Bool
+_cmap_static_build(cmap_static_t *smap, _cmap_static_key_t *all, size_t n, size_t nthreads) {
+    // Level 0 is the largest, so the marking bitsets are sized for it and reused.
+    const size_t max_words = ((size_t)(n * _CMS_GAMMA) + 63) / 64 + 1;
+    _cmap_static_key_t *work = malloc(_CMMAX(n, 1) * sizeof(_cmap_static_key_t));
+    _cmap_static_task_t *tasks = malloc(nthreads * sizeof(_cmap_static_task_t));
+    _Atomic uint64_t *seen = malloc(max_words * sizeof(uint64_t));
+    _Atomic uint64_t *collided = malloc(max_words * sizeof(uint64_t));
+    _Bool ok = work && tasks && seen && collided;
+    if (ok) {
+        memcpy(work, all, n * sizeof(_cmap_static_key_t));
+    }
+
+    size_t remaining = n;
+    size_t total_words = 0;
+    while (ok && remaining && smap->_level_count < _CMS_MAX_LEVELS) {
+        const size_t level = smap->_level_count;
+        const size_t nwords = ((size_t)(remaining * _CMS_GAMMA) + 63) / 64;
+        const size_t ntasks = _CMMIN(nthreads, _CMMAX(remaining / _CMS_MIN_CHUNK, 1));
+        uint64_t *bits = realloc(smap->_bits, (total_words + nwords) * sizeof(uint64_t));
+        if (!bits) {
+            ok = _CMFALSE;
+            break;
+        }
+        smap->_bits = bits;
+        _CMFOR(i, 0, nwords, 1) {
+            atomic_init(&seen[i], 0);
+            atomic_init(&collided[i], 0);
+        }
+        smap->_level_offsets[level + 1] = (total_words + nwords) * 64;
+        _cmap_static_task_t base = {
+            .map = smap, .keys = work, .level = level, .seen = seen, .collided = collided
+        };
+
+        base.phase = _CMS_PHASE_MARK;
+        ok = _cmap_static_run(tasks, ntasks, base, remaining);
+        _CMFOR(i, 0, nwords, 1) {
+            smap->_bits[total_words + i] = atomic_load(&seen[i]) & ~atomic_load(&collided[i]);
+        }
+        base.phase = _CMS_PHASE_FILTER;
+        ok = ok && _cmap_static_run(tasks, ntasks, base, remaining);
+
+        // Every task compacted its survivors to the front of its range. Join the ranges.
+        size_t survivors = 0;
+        _CMFOR(i, 0, ntasks, 1) {
+            memmove(
+                &work[survivors], &work[tasks[i].begin],
+                tasks[i].survivors * sizeof(_cmap_static_key_t)
+            );
+            survivors += tasks[i].survivors;
+        }
+        remaining = survivors;
+        total_words += nwords;
+        ++smap->_level_count;
+    }
+    free((void *)seen);
+    free((void *)collided);
+
+    // Cumulative ranks, then slots.
+    const size_t nblocks = total_words / _CMS_RANK_WORDS + 1;
+    smap->_ranks = ok ? malloc(nblocks * sizeof(uint64_t)) : NULL;
+    ok = ok && smap->_ranks;
+    if (ok) {
+        uint64_t rank = 0;
+        _CMFOR(i, 0, nblocks * _CMS_RANK_WORDS, 1) {
+            if (i % _CMS_RANK_WORDS == 0) {
+                smap->_ranks[i / _CMS_RANK_WORDS] = rank;
+            }
+            rank += i < total_words ? _cmap_popcount64(smap->_bits[i]) : 0;
+        }
+        smap->_slot_count = (size_t)rank;
+        smap->_slots = malloc(_CMMAX(smap->_slot_count, 1) * sizeof(cmap_entry_t));
+        ok = smap->_slots != NULL;
+    }
+    if (ok) {
+        _cmap_static_task_t base = {.map = smap, .phase = _CMS_PHASE_PLACE, .keys = all};
+        ok = _cmap_static_run(tasks, _CMMIN(nthreads, _CMMAX(n / _CMS_MIN_CHUNK, 1)), base, n);
+    }
+
+    // Keys that never resolved (e.g. distinct keys with equal hashes) go to the fallback.
+    if (ok && remaining) {
+        ok = cmap_init(
+            &smap->_fallback, sizeof(void *), sizeof(void *), remaining * 2, smap->_hash_func,
+            smap->_comparison_func, NULL, NULL
+        );
+        for (size_t i = 0; ok && i < remaining; ++i) {
+            ok = _cmap_insert_hashed(smap->_fallback, work[i].key, work[i].value, work[i].hash);
+        }
+    }
+    smap->_size = smap->_slot_count + (smap->_fallback ? smap->_fallback->_size : 0);
+    free(work);
+    free(tasks);
+    return ok;
+}
+
+// Uninitializes a pointer to a cmap_static_t instance. Keys and values are not destroyed.
+_CMSTCINL void cmap_static_uninit(cmap_static_t **map) {
+    _CMREQUIRE(map && *map, return);
+    cmap_static_t *smap = *map;
+    free(smap->_bits);
+    free(smap->_ranks);
+    free(smap->_slots);
+    if (smap->_fallback) {
+        cmap_uninit(&smap->_fallback);
+    }
+    free(smap);
+    *map = NULL;
+}
+
+/*
+    Initializes a given pointer with a static map of `n` key-value pairs. Keys must be distinct.
+    Construction is split across `threads` threads (0 picks one) once there are enough keys.
+    The map does not own its keys and values, which must outlive it.
+*/
+_CMSTCINL _Bool cmap_static_init_from_arrays(
+    cmap_static_t **map,
+    void *const *keys,
+    void *const *values,
+    size_t n,
+    size_t (*hash_func)(const void *),
+    int (*comparison_func)(const void *, const void *),
+    size_t threads
+) {
+    _CMREQUIRE(map && (keys || !n) && hash_func && comparison_func, return _CMFALSE);
+    threads = _CMMIN(_CMMAX(threads, 1), _CMS_MAX_THREADS);
+    _CMREQUIRE(n < SIZE_MAX / 2 / sizeof(_cmap_static_key_t), return _CMFALSE);
+    cmap_static_t *smap = calloc(1, sizeof(cmap_static_t));
+    _CMREQUIRE(smap, return _CMFALSE);
+    smap->_hash_func = hash_func;
+    smap->_comparison_func = comparison_func;
+    _cmap_static_key_t *all = malloc(_CMMAX(n, 1) * sizeof(_cmap_static_key_t));
+    _CMREQUIRE(all, free(smap); return _CMFALSE);
+    _CMFOR(i, 0, n, 1) {
+        all[i] = (_cmap_static_key_t){
+            .hash = hash_func(keys[i]), .key = keys[i], .value = values ? values[i] : NULL
+        };
+    }
+    const _Bool ok = _cmap_static_build(smap, all, n, threads);
+    free(all);
+    _CMREQUIRE(ok, cmap_static_uninit(&smap); return _CMFALSE);
+    *map = smap;
+    return _CMTRUE;
+}
+
+// Initializes a given pointer with a static map holding every entry of `src`, using its hash and
+// comparison functions. `src` keeps ownership of the keys and values, and must outlive the map.
+_CMSTCINL _Bool cmap_static_init(cmap_static_t **map, cmap_t **src, size_t threads) {
+    _CMREQUIRE(map && src && *src, return _CMFALSE);
+    cmap_t *cmap = *src;
+    const size_t n = cmap->_size;
+    void **pairs = malloc(_CMMAX(n, 1) * 2 * sizeof(void *));
+    _CMREQUIRE(pairs, return _CMFALSE);
+    cmap_iterator_t iter;
+    cmap_entry_t entry;
+    size_t i = 0;
+    for (_Bool ok = cmap_iter_start(src, &iter, &entry); ok; ok = cmap_iter_next(&iter, &entry)) {
+        pairs[i] = entry.key;
+        pairs[n + i++] = entry.value;
+    }
+    const _Bool ret = cmap_static_init_from_arrays(
+        map, pairs, pairs + n, n, cmap->_hash_func, cmap->_comparison_func, threads
+    );
+    free(pairs);
+    return ret;
+}
+
+// Gets the value and assigns it to an out-parameter. Costs one slot probe and one comparison.
+_CMSTCINL _Bool cmap_static_get(cmap_static_t **map, const void *key, void **out) {
+    _CMREQUIRE(map && *map && out, return _CMFALSE);
+    const cmap_static_t *smap = *map;
+    const size_t hash = smap->_hash_func(key);
+    const size_t slot = _cmap_static_slot(smap, hash);
+    if (slot != SIZE_MAX && smap->_comparison_func(smap->_slots[slot].key, key) == 0) {
+        *out = smap->_slots[slot].value;
+        return _CMTRUE;
+    }
+    cmap_entry_t *entry = smap->_fallback ? _cmap_find(smap->_fallback, key, hash) : NULL;
+    _CMREQUIRE(entry, return _CMFALSE);
+    *out = entry->value;
+    return _CMTRUE;
+}
+
+// Macro API accessors.
+#define CMAP_STATIC_SIZE(map) (map->_size)
+#define CMAP_STATIC_LEVEL_COUNT(map) (map->_level_count)
+
+// Macro API functions.
+#define CMAP_STATIC_INIT(map, src, threads) (cmap_static_init(&map, &src, threads))
+#define CMAP_STATIC_INIT_FROM_ARRAYS(map, keys, values, n, hash_func, cmp_func, threads)           \
+    (cmap_static_init_from_arrays(                                                                 \
+        &map, (void *const *)keys, (void *const *)values, n, hash_func, cmp_func, threads          \
+    ))
+#define CMAP_STATIC_UNINIT(map) (cmap_static_uninit(&map))
+#define CMAP_STATIC_GETVAL(map, key, out)                                                          \
+    (cmap_static_get(&map, (const void *)key, (void **)&out))
@@ -0,0 +1,254 @@
+/*  cpool.h
+ *  A minimal size-classed slab pool allocator in C.
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "callocator.h"
+
+// Utility macros.
+#define _CPSTCINL static inline
+#define _CPREQUIRE(condition, action)                                                              \
+    do {                                                                                           \
+        if (!(condition)) {                                                                        \
+            action;                                                                                \
+        }                                                                                          \
+    } while (0)
+#define _CPFALSE 0
+#define _CPTRUE 1
+#define _CPFOR(iter, start, end, step) for (size_t iter = (start); iter < (end); iter += (step))
+
+#define _CP_MIN_CLASS 4                     // Smallest block is 16 bytes.
+#define _CP_CLASS_COUNT (sizeof(size_t) * 8) // One free list per power of two.
+#define _CP_MIN_SLAB ((size_t)4096)
+#define _CP_MAX_SLAB ((size_t)1 << 20)
+#define _CP_MAX_BLOCK (_CP_MAX_SLAB / 4) // Larger blocks get a dedicated slab each.
+
+// Slab header, followed by the memory blocks are carved from.
+typedef struct cpool_slab {
+    struct cpool_slab *_prev;
+    struct cpool_slab *_next;
+    size_t _size; // Usable bytes after the header.
+    size_t _used;
+} cpool_slab_t;
+
+// Pool header data.
+typedef struct {
+    cpool_slab_t *_slabs; // The head is the slab currently being carved.
+    void *_free_lists[_CP_CLASS_COUNT];
+    size_t _next_slab_size;
+    size_t _slab_count;
+    const callocator_t *_allocator; // Slabs come from it. NULL for malloc().
+} cpool_t;
+
+// Returns the size class (log2 of the block size) that serves a given size.
+_CPSTCINL size_t _cpool_class(size_t size) {
+    size_t cls = _CP_MIN_CLASS;
+    while (((size_t)1 << cls) < size) {
+        ++cls;
+    }
+    return cls;
+}
+
+// Links a new slab of at least `min_size` usable bytes. Slabs that blocks are carved from go to the
+// front of the list, dedicated slabs of large blocks go right behind it.
+_CPSTCINL cpool_slab_t *_cpool_add_slab(cpool_t *pool, size_t min_size, _Bool dedicated) {
+    size_t size = dedicated || min_size > pool->_next_slab_size ? min_size : pool->_next_slab_size;
+    _CPREQUIRE(size <= SIZE_MAX - sizeof(cpool_slab_t), return NULL);
+    cpool_slab_t *slab = callocator_alloc(pool->_allocator, sizeof(cpool_slab_t) + size, 0);
+    _CPREQUIRE(slab, return NULL);
+    *slab = (cpool_slab_t){._prev = NULL, ._next = pool->_slabs, ._size = size, ._used = 0};
+    if (dedicated && pool->_slabs) {
+        slab->_prev = pool->_slabs;
+        slab->_next = pool->_slabs->_next;
+        pool->_slabs->_next = slab;
+    } else {
+        pool->_slabs = slab;
+    }
+    if (slab->_next) {
+        slab->_next->_prev = slab;
+    }
+    ++pool->_slab_count;
+    if (!dedicated && pool->_next_slab_size < _CP_MAX_SLAB) {
+        pool->_next_slab_size *= 2; // Slabs grow geometrically, so small pools stay small.
+    }
+    return slab;
+}
+
+// Unlinks a slab from the slab list and releases it.
+_CPSTCINL void _cpool_drop_slab(cpool_t *pool, cpool_slab_t *slab) {
+    if (slab->_prev) {
+        slab->_prev->_next = slab->_next;
+    } else {
+        pool->_slabs = slab->_next;
+    }
+    if (slab->_next) {
+        slab->_next->_prev = slab->_prev;
+    }
+    --pool->_slab_count;
+    callocator_free(pool->_allocator, slab, sizeof(cpool_slab_t) + slab->_size);
+}
+
+// Initializes a given pointer with an empty pool whose slabs, and itself, come from `allocator`
+// (NULL for malloc()). No slab is allocated until first use.
+_CPSTCINL _Bool cpool_init_with(cpool_t **pool, const callocator_t *allocator) {
+    _CPREQUIRE(pool, return _CPFALSE);
+    cpool_t *cpool = callocator_calloc(allocator, 1, sizeof(cpool_t));
+    _CPREQUIRE(cpool, return _CPFALSE);
+    cpool->_next_slab_size = _CP_MIN_SLAB;
+    cpool->_allocator = allocator;
+    *pool = cpool;
+    return _CPTRUE;
+}
+
+// Initializes a given pointer with an empty pool. No slab is allocated until first use.
+_CPSTCINL _Bool cpool_init(cpool_t **pool) { return cpool_init_with(pool, NULL); }
+
+// Releases every slab at once, invalidating all blocks handed out by the pool.
+_CPSTCINL void cpool_reset(cpool_t **pool) {
+    _CPREQUIRE(pool && *pool, return);
+    cpool_t *cpool = *pool;
+    while (cpool->_slabs) {
+        cpool_slab_t *next = cpool->_slabs->_next;
+        callocator_free(
+            cpool->_allocator, cpool->_slabs, sizeof(cpool_slab_t) + cpool->_slabs->_size
+        );
+        cpool->_slabs = next;
+    }
+    memset(cpool->_free_lists, 0, sizeof(cpool->_free_lists));
+    cpool->_next_slab_size = _CP_MIN_SLAB;
+    cpool->_slab_count = 0;
+}
+
+// Uninitializes a pointer to a pool, releasing all of its slabs.
+_CPSTCINL void cpool_uninit(cpool_t **pool) {
+    _CPREQUIRE(pool && *pool, return);
+    cpool_reset(pool);
+    callocator_free((*pool)->_allocator, *pool, sizeof(cpool_t));
+    *pool = NULL;
+}
+
+// Allocates a block of at least `size` bytes, aligned to 16 bytes.
+_CPSTCINL void *cpool_alloc(cpool_t **pool, size_t size) {
+    _CPREQUIRE(pool && *pool && size, return NULL);
+    _CPREQUIRE(size <= SIZE_MAX / 2, return NULL);
+    cpool_t *cpool = *pool;
+    const size_t cls = _cpool_class(size);
+    const size_t block_size = (size_t)1 << cls;
+    if (block_size > _CP_MAX_BLOCK) {
+        cpool_slab_t *slab = _cpool_add_slab(cpool, block_size, _CPTRUE);
+        _CPREQUIRE(slab, return NULL);
+        slab->_used = block_size;
+        return slab + 1;
+    }
+    void *block = cpool->_free_lists[cls];
+    if (block) {
+        memcpy(&cpool->_free_lists[cls], block, sizeof(void *));
+        return block;
+    }
+    cpool_slab_t *slab = cpool->_slabs;
+    if (!slab || slab->_size - slab->_used < block_size) {
+        slab = _cpool_add_slab(cpool, block_size, _CPFALSE);
+        _CPREQUIRE(slab, return NULL);
+    }
+    block = (char *)(slab + 1) + slab->_used;
+    slab->_used += block_size;
+    return block;
+}
+
+// Returns a block to its size-class free list. `size` must match the size it was allocated with.
+_CPSTCINL void cpool_free(cpool_t **pool, void *block, size_t size) {
+    _CPREQUIRE(pool && *pool && block, return);
+    cpool_t *cpool = *pool;
+    const size_t cls = _cpool_class(size);
+    if (((size_t)1 << cls) > _CP_MAX_BLOCK) {
+        _cpool_drop_slab(cpool, (cpool_slab_t *)block - 1);
+        return;
+    }
+    memcpy(block, &cpool->_free_lists[cls], sizeof(void *));
+    cpool->_free_lists[cls] = block;
+}
+
+// Resizes a block, keeping it in place when both sizes share a size class.
+_CPSTCINL void *cpool_realloc(cpool_t **pool, void *block, size_t old_size, size_t new_size) {
+    _CPREQUIRE(pool && *pool, return NULL);
+    _CPREQUIRE(block, return cpool_alloc(pool, new_size));
+    if (_cpool_class(old_size) == _cpool_class(new_size)) {
+        return block;
+    }
+    void *nblock = cpool_alloc(pool, new_size);
+    _CPREQUIRE(nblock, return NULL);
+    memcpy(nblock, block, old_size < new_size ? old_size : new_size);
+    cpool_free(pool, block, old_size);
+    return nblock;
+}
+
+/*
+    Moves every slab and free block of `src` into `dst`, then uninitializes `src`. Blocks handed
+    out by `src` stay valid, and must be freed through `dst` from then on. Lets threads allocate
+    from private pools and hand their blocks over to a shared one afterwards. Both pools must share
+    an allocator.
+*/
+_CPSTCINL void cpool_absorb(cpool_t **dst, cpool_t **src) {
+    _CPREQUIRE(dst && *dst && src && *src && *dst != *src, return);
+    _CPREQUIRE((*dst)->_allocator == (*src)->_allocator, return);
+    cpool_t *to = *dst;
+    cpool_t *from = *src;
+    if (from->_slabs) {
+        // Linked behind the head of `dst`, which keeps carving from its current slab.
+        cpool_slab_t *tail = from->_slabs;
+        while (tail->_next) {
+            tail = tail->_next;
+        }
+        if (to->_slabs) {
+            tail->_next = to->_slabs->_next;
+            if (tail->_next) {
+                tail->_next->_prev = tail;
+            }
+            to->_slabs->_next = from->_slabs;
+            from->_slabs->_prev = to->_slabs;
+        } else {
+            to->_slabs = from->_slabs;
+        }
+        to->_slab_count += from->_slab_count;
+    }
+    _CPFOR(cls, 0, _CP_CLASS_COUNT, 1) {
+        void *block = from->_free_lists[cls];
+        if (!block) {
+            continue;
+        }
+        void *next = NULL;
+        memcpy(&next, block, sizeof(void *));
+        while (next) {
+            block = next;
+            memcpy(&next, block, sizeof(void *));
+        }
+        memcpy(block, &to->_free_lists[cls], sizeof(void *));
+        to->_free_lists[cls] = from->_free_lists[cls];
+    }
+    if (from->_next_slab_size > to->_next_slab_size) {
+        to->_next_slab_size = from->_next_slab_size;
+    }
+    callocator_free(from->_allocator, from, sizeof(cpool_t));
+    *src = NULL;
+}
+
+// Macro API accessors.
+#define CPOOL_SLAB_COUNT(pool) (pool->_slab_count)
+
+// Macro API functions.
+#define CPOOL_INIT(pool) (cpool_init(&pool))
+#define CPOOL_INIT_WITH(pool, allocator) (cpool_init_with(&pool, allocator))
+#define CPOOL_UNINIT(pool) (cpool_uninit(&pool))
+#define CPOOL_RESET(pool) (cpool_reset(&pool))
+#define CPOOL_ALLOC(pool, size) (cpool_alloc(&pool, size))
+#define CPOOL_FREE(pool, block, size) (cpool_free(&pool, block, size))
+#define CPOOL_REALLOC(pool, block, old_size, new_size)                                             \
+    (cpool_realloc(&pool, block, old_size, new_size))
+#define CPOOL_ABSORB(dst, src) (cpool_absorb(&dst, &src))
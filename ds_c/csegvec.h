@@ -0,0 +1,228 @@
+/*  csegvec.h
+ *  A segmented vector in C. Elements never move, so their addresses stay valid across growth.
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "callocator.h"
+
+// Utility macros.
+#define _CSVSTCINL static inline
+#define _CSVREQUIRE(condition, action)                                                             \
+    do {                                                                                           \
+        if (!(condition)) {                                                                        \
+            action;                                                                                \
+        }                                                                                          \
+    } while (0)
+#define _CSVFALSE 0
+#define _CSVTRUE 1
+#define _CSVFOR(iter, start, end, step) for (size_t iter = (start); iter < (end); iter += (step))
+
+#define _CSV_MAX_BLOCKS (sizeof(size_t) * 8)
+#define _CSV_DEFAULT_FIRST 16
+#define _CSV_BLOCK_ALIGN 64 // Blocks start on a cache line, for aligned SIMD loads.
+
+/*
+    Segmented vector header data. Block k holds `first << k` elements, so the blocks double in
+    size and the first k blocks hold `(first << k) - first` elements. Growing allocates the next
+    block instead of moving the existing ones.
+*/
+typedef struct {
+    void *_blocks[_CSV_MAX_BLOCKS]; // Directory of the allocated blocks.
+    size_t _block_count;
+    size_t _capacity;
+    size_t _size;
+    size_t _element_size;
+    uint8_t _first_shift; // log2 of the first block's length.
+    void (*_destructor)(void *);
+    const callocator_t *_allocator; // NULL for malloc().
+} csegvec_t;
+
+// Returns the index of the highest set bit of a non-zero value.
+_CSVSTCINL size_t _csegvec_log2(size_t n) {
+#if defined(__GNUC__) || defined(__clang__)
+#if SIZE_MAX == UINT64_MAX
+    return 63 - (size_t)__builtin_clzll((unsigned long long)n);
+#else
+    return 31 - (size_t)__builtin_clz((unsigned)n);
+#endif
+#else
+    size_t log = 0;
+    while (n >>= 1) {
+        ++log;
+    }
+    return log;
+#endif
+}
+
+// Returns the address of an element below the capacity. Element i lives in block k, where k is
+// the highest set bit of `i + first` above the first block's, at the offset given by the bits
+// below it.
+_CSVSTCINL void *_csegvec_at(const csegvec_t *csegvec, size_t index) {
+    const size_t biased = index + ((size_t)1 << csegvec->_first_shift);
+    const size_t log = _csegvec_log2(biased);
+    const size_t offset = biased - ((size_t)1 << log);
+    return (char *)csegvec->_blocks[log - csegvec->_first_shift] +
+           offset * csegvec->_element_size;
+}
+
+// Allocates the next block.
+_CSVSTCINL _Bool _csegvec_grow(csegvec_t *csegvec) {
+    const size_t k = csegvec->_block_count;
+    _CSVREQUIRE(csegvec->_first_shift + k < _CSV_MAX_BLOCKS - 1, return _CSVFALSE);
+    const size_t length = (size_t)1 << (csegvec->_first_shift + k);
+    _CSVREQUIRE(length < SIZE_MAX / csegvec->_element_size, return _CSVFALSE);
+    void *block =
+        callocator_alloc(csegvec->_allocator, length * csegvec->_element_size, _CSV_BLOCK_ALIGN);
+    _CSVREQUIRE(block, return _CSVFALSE);
+    csegvec->_blocks[k] = block;
+    ++csegvec->_block_count;
+    csegvec->_capacity += length;
+    return _CSVTRUE;
+}
+
+/*
+    Initializes a given pointer with a segmented vector, allocating through `allocator` (NULL for
+    malloc()). The first block holds `first_block` elements, rounded up to a power of two (0 for a
+    default). No block is allocated until first use.
+*/
+_CSVSTCINL _Bool csegvec_init_with(
+    csegvec_t **vec,
+    size_t element_size,
+    size_t first_block,
+    void (*destructor)(void *),
+    const callocator_t *allocator
+) {
+    _CSVREQUIRE(vec && element_size, return _CSVFALSE);
+    first_block = first_block ? first_block : _CSV_DEFAULT_FIRST;
+    _CSVREQUIRE(first_block <= SIZE_MAX / 4, return _CSVFALSE);
+    csegvec_t *csegvec = callocator_alloc(allocator, sizeof(csegvec_t), 0);
+    _CSVREQUIRE(csegvec, return _CSVFALSE);
+    *csegvec = (csegvec_t){._block_count = 0,
+                           ._capacity = 0,
+                           ._size = 0,
+                           ._element_size = element_size,
+                           ._first_shift = (uint8_t)_csegvec_log2(first_block),
+                           ._destructor = destructor,
+                           ._allocator = allocator};
+    if (((size_t)1 << csegvec->_first_shift) < first_block) {
+        ++csegvec->_first_shift;
+    }
+    *vec = csegvec;
+    return _CSVTRUE;
+}
+
+// Initializes a given pointer with a segmented vector.
+_CSVSTCINL _Bool csegvec_init(
+    csegvec_t **vec, size_t element_size, size_t first_block, void (*destructor)(void *)
+) {
+    return csegvec_init_with(vec, element_size, first_block, destructor, NULL);
+}
+
+// Destroys every element, should a destructor be provided. Keeps the blocks.
+_CSVSTCINL void csegvec_clear(csegvec_t **vec) {
+    _CSVREQUIRE(vec && *vec, return);
+    csegvec_t *csegvec = *vec;
+    if (csegvec->_destructor) {
+        _CSVFOR(i, 0, csegvec->_size, 1) { csegvec->_destructor(_csegvec_at(csegvec, i)); }
+    }
+    csegvec->_size = 0;
+}
+
+// Uninitializes/destroys a segmented vector along with its elements.
+_CSVSTCINL void csegvec_uninit(csegvec_t **vec) {
+    _CSVREQUIRE(vec && *vec, return);
+    csegvec_t *csegvec = *vec;
+    csegvec_clear(vec);
+    _CSVFOR(k, 0, csegvec->_block_count, 1) {
+        const size_t length = (size_t)1 << (csegvec->_first_shift + k);
+        callocator_free(csegvec->_allocator, csegvec->_blocks[k], length * csegvec->_element_size);
+    }
+    callocator_free(csegvec->_allocator, csegvec, sizeof(csegvec_t));
+    *vec = NULL;
+}
+
+// Guarantees the capacity >= specified capacity, allocating blocks without moving any element.
+_CSVSTCINL _Bool csegvec_reserve(csegvec_t **vec, size_t capacity) {
+    _CSVREQUIRE(vec && *vec, return _CSVFALSE);
+    while ((*vec)->_capacity < capacity) {
+        _CSVREQUIRE(_csegvec_grow(*vec), return _CSVFALSE);
+    }
+    return _CSVTRUE;
+}
+
+// Pushes an element to the end of the segmented vector. Never moves the other elements.
+_CSVSTCINL _Bool csegvec_pushback(csegvec_t **vec, const void *element) {
+    _CSVREQUIRE(vec && *vec && element, return _CSVFALSE);
+    csegvec_t *csegvec = *vec;
+    if (csegvec->_size == csegvec->_capacity) {
+        _CSVREQUIRE(_csegvec_grow(csegvec), return _CSVFALSE);
+    }
+    memcpy(_csegvec_at(csegvec, csegvec->_size), element, csegvec->_element_size);
+    ++csegvec->_size;
+    return _CSVTRUE;
+}
+
+// Pops the last element of the segmented vector.
+_CSVSTCINL void csegvec_popback(csegvec_t **vec) {
+    _CSVREQUIRE(vec && *vec && (*vec)->_size, return);
+    csegvec_t *csegvec = *vec;
+    --csegvec->_size;
+    if (csegvec->_destructor) {
+        csegvec->_destructor(_csegvec_at(csegvec, csegvec->_size));
+    }
+}
+
+// Returns the address of an element, or `NULL` if the index is out of range. The address stays
+// valid until the element is removed.
+_CSVSTCINL void *csegvec_at(csegvec_t **vec, size_t index) {
+    _CSVREQUIRE(vec && *vec && index < (*vec)->_size, return NULL);
+    return _csegvec_at(*vec, index);
+}
+
+/*
+    Returns the address of an element along with, through `out_count`, the number of elements that
+    are contiguous from it: up to the end of its block or of the vector. Walks the vector in
+    contiguous spans, e.g. for SIMD kernels, as
+        for (size_t i = 0, n; i < CSEGVEC_SIZE(vec); i += n) {
+            T *span = csegvec_span(&vec, i, &n);
+        }
+    Returns `NULL` if the index is out of range.
+*/
+_CSVSTCINL void *csegvec_span(csegvec_t **vec, size_t index, size_t *out_count) {
+    _CSVREQUIRE(vec && *vec && out_count && index < (*vec)->_size, return NULL);
+    const csegvec_t *csegvec = *vec;
+    const size_t biased = index + ((size_t)1 << csegvec->_first_shift);
+    const size_t log = _csegvec_log2(biased);
+    const size_t block_left = ((size_t)2 << log) - biased;
+    const size_t left = csegvec->_size - index;
+    *out_count = block_left < left ? block_left : left;
+    return (char *)csegvec->_blocks[log - csegvec->_first_shift] +
+           (biased - ((size_t)1 << log)) * csegvec->_element_size;
+}
+
+// Macro API accessors.
+#define CSEGVEC_SIZE(vec) (vec->_size)
+#define CSEGVEC_CAPACITY(vec) (vec->_capacity)
+#define CSEGVEC_ESIZE(vec) (vec->_element_size)
+#define CSEGVEC_BLOCK_COUNT(vec) (vec->_block_count)
+
+// Macro API functions.
+#define CSEGVEC_INIT(vec, type, first_block, destructor)                                           \
+    (csegvec_init(&vec, sizeof(type), first_block, destructor))
+#define CSEGVEC_INIT_WITH(vec, type, first_block, destructor, allocator)                           \
+    (csegvec_init_with(&vec, sizeof(type), first_block, destructor, allocator))
+#define CSEGVEC_UNINIT(vec) (csegvec_uninit(&vec))
+#define CSEGVEC_CLEAR(vec) (csegvec_clear(&vec))
+#define CSEGVEC_RESERVE(vec, capacity) (csegvec_reserve(&vec, capacity))
+#define CSEGVEC_POPBACK(vec) (csegvec_popback(&vec))
+#define CSEGVEC_AT(vec, type, index) ((type *)csegvec_at(&vec, index))
+#define CSEGVEC_SPAN(vec, type, index, out_count) ((type *)csegvec_span(&vec, index, out_count))
+#define CSEGVEC_PUSHBACK(vec, type, element)                                                       \
+    (csegvec_pushback(&vec, (const void *)&(type){element}))
@@ -0,0 +1,456 @@
+/*  cset.h
+ *  A minimal hash set (a.k.a std::unordered_set) implementation in C, on cmap.h's hashing.
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+#include "cmap.h"
+
+#define _CS_INLINE_SIZE 2 // Keeps a bucket at 32 bytes on 64-bit targets, two per cache line.
+
+// Keys-only counterpart of cmap_bucket_t.
+typedef struct {
+    void *_inline_keys[_CS_INLINE_SIZE];
+    void **_overflow_keys;
+    uint16_t _overflow_capacity;
+    uint16_t _total_keys;
+    _Bool _occupied;
+} cset_bucket_t;
+
+typedef struct {
+    cset_bucket_t *_buckets;
+    cpool_t *_pool; // Overflow arrays of `_buckets`.
+    size_t _size;
+    size_t _capacity;  // Buckets. Always a power of two.
+    uint8_t _key_size; // Limited to sizeof(void*). Otherwise, store indirectly through a pointer.
+    size_t (*_hash_func)(const void *);
+    int (*_comparison_func)(const void *, const void *); // Receives the element to be compared.
+    void (*_key_destructor)(void **); // Receives a pointer to the element to be destroyed.
+    const callocator_t *_allocator;   // Allocates the set and its storage. NULL for malloc().
+} cset_t;
+
+typedef struct {
+    cset_t *set;
+    size_t bucket_idx;
+    size_t st_idx;
+} cset_iterator_t;
+
+// Allocates a bucket array with every inline key marked as empty.
+_CMSTCINL cset_bucket_t *_cset_bucket_alloc(const callocator_t *allocator, size_t capacity) {
+    cset_bucket_t *buckets = callocator_calloc(allocator, capacity, sizeof(cset_bucket_t));
+    _CMREQUIRE(buckets, return NULL);
+    _CMFOR(i, 0, capacity, 1) {
+        _CMFOR(j, 0, _CS_INLINE_SIZE, 1) { buckets[i]._inline_keys[j] = (void *)_CMSENTINEL; }
+    }
+    return buckets;
+}
+
+// Releases a bucket array of `capacity` buckets, but not the overflow arrays in its pool.
+_CMSTCINL void _cset_bucket_free(cset_t *cset, cset_bucket_t *buckets, size_t capacity) {
+    callocator_free(cset->_allocator, buckets, capacity * sizeof(cset_bucket_t));
+}
+
+// Returns the j-th key slot of a bucket, counting the inline keys first.
+_CMSTCINL void **_cset_bucket_key(cset_bucket_t *bucket, size_t j) {
+    return j < _CS_INLINE_SIZE ? &bucket->_inline_keys[j]
+                               : &bucket->_overflow_keys[j - _CS_INLINE_SIZE];
+}
+
+// Returns the slot of a key within a given bucket if found, else returns `NULL`.
+_CMSTCINL void **_cset_bucket_scan(const cset_t *cset, cset_bucket_t *bucket, const void *key) {
+    if (!bucket->_occupied) {
+        return NULL;
+    }
+    const size_t tbkt_capacity = bucket->_overflow_capacity + _CS_INLINE_SIZE;
+    _CMFOR(j, 0, tbkt_capacity, 1) {
+        void **slot = _cset_bucket_key(bucket, j);
+        if (*slot != (void *)_CMSENTINEL && cset->_comparison_func(*slot, key) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+// Places a key that is known to be absent into a given bucket, growing its overflow array within
+// `pool`. Does not update `_size`.
+_CMSTCINL _Bool _cset_bucket_place(cset_bucket_t *bucket, cpool_t **pool, void *key) {
+    const size_t tbkt_capacity = bucket->_overflow_capacity + _CS_INLINE_SIZE;
+    size_t slot_idx = SIZE_MAX;
+    _CMFOR(j, 0, tbkt_capacity, 1) {
+        if (*_cset_bucket_key(bucket, j) == (void *)_CMSENTINEL) {
+            slot_idx = j;
+            break;
+        }
+    }
+
+    // All slots are used, (re)allocate overflow and set the slot to the end.
+    if (slot_idx == SIZE_MAX) {
+        const size_t prv_capacity = bucket->_overflow_capacity;
+        size_t ncapacity = 0;
+        _CMREQUIRE(
+            _cmap_mdfd_n2exp_alloc(
+                pool, (void **)&bucket->_overflow_keys, prv_capacity, _CMMAX(prv_capacity + 1, 2),
+                sizeof(void *), &ncapacity
+            ),
+            return _CMFALSE
+        );
+        _CMFOR(i, prv_capacity, ncapacity, 1) { bucket->_overflow_keys[i] = (void *)_CMSENTINEL; }
+        slot_idx = _CS_INLINE_SIZE + prv_capacity;
+        bucket->_overflow_capacity = ncapacity;
+    }
+    *_cset_bucket_key(bucket, slot_idx) = key;
+    ++bucket->_total_keys;
+    bucket->_occupied = _CMTRUE;
+    return _CMTRUE;
+}
+
+// Empties a key slot of a bucket without destroying the key.
+_CMSTCINL void _cset_bucket_clear(cset_t *cset, cset_bucket_t *bucket, void **slot) {
+    *slot = (void *)_CMSENTINEL;
+    --cset->_size;
+    if (!--bucket->_total_keys) {
+        bucket->_occupied = _CMFALSE;
+    }
+}
+
+// Returns the smallest capacity that holds `nsize` keys below the maximum load factor.
+_CMSTCINL size_t _cset_fit_capacity(size_t nsize) {
+    return _CMMAX(_cmap_nexp2((size_t)(nsize / _CMLFACTOR_LIMIT) + 1), 2);
+}
+
+// Rehashes every key into a new bucket array in a single pass. The new array gets a fresh pool, so
+// the previous overflow storage is released by dropping whole slabs.
+_CMSTCINL _Bool _cset_rehash(cset_t *cset, size_t new_capacity) {
+    cpool_t *new_pool = NULL;
+    _CMREQUIRE(cpool_init_with(&new_pool, cset->_allocator), return _CMFALSE);
+    cset_bucket_t *new_buckets = _cset_bucket_alloc(cset->_allocator, new_capacity);
+    _CMREQUIRE(new_buckets, cpool_uninit(&new_pool); return _CMFALSE);
+    _CMFOR(i, 0, cset->_capacity, 1) {
+        cset_bucket_t *bucket = &cset->_buckets[i];
+        if (!bucket->_occupied) {
+            continue;
+        }
+        const size_t tbkt_capacity = bucket->_overflow_capacity + _CS_INLINE_SIZE;
+        _CMFOR(j, 0, tbkt_capacity, 1) {
+            void *key = *_cset_bucket_key(bucket, j);
+            if (key == (void *)_CMSENTINEL) {
+                continue;
+            }
+            cset_bucket_t *target = &new_buckets[cset->_hash_func(key) & (new_capacity - 1)];
+            if (!_cset_bucket_place(target, &new_pool, key)) {
+                // The keys are still owned by the previous buckets, so only storage is released.
+                _cset_bucket_free(cset, new_buckets, new_capacity);
+                cpool_uninit(&new_pool);
+                return _CMFALSE;
+            }
+        }
+    }
+    _cset_bucket_free(cset, cset->_buckets, cset->_capacity);
+    cpool_uninit(&cset->_pool);
+    cset->_buckets = new_buckets;
+    cset->_capacity = new_capacity;
+    cset->_pool = new_pool;
+    return _CMTRUE;
+}
+
+// Shrinks a set to fit its keys once the load drops below the minimum load factor.
+_CMSTCINL void _cset_shrink(cset_t *cset) {
+    if (cset->_capacity > 2 && cset->_size < cset->_capacity * _CMLFACTOR_MIN) {
+        _cset_rehash(cset, _cset_fit_capacity(cset->_size)); // Still valid if this fails.
+    }
+}
+
+// Initializes a given pointer with a cset_t instance, allocating through `allocator` (NULL for
+// malloc()).
+_CMSTCINL _Bool cset_init_with(
+    cset_t **set,
+    size_t key_size,
+    size_t initial_capacity,
+    size_t (*hash_func)(const void *),
+    int (*comparison_func)(const void *, const void *),
+    void (*key_destructor)(void **),
+    const callocator_t *allocator
+) {
+    _CMREQUIRE(set && key_size && hash_func && comparison_func, return _CMFALSE);
+    _CMREQUIRE(key_size <= sizeof(void *), return _CMFALSE);
+    _CMREQUIRE(initial_capacity < SIZE_MAX / sizeof(cset_bucket_t), return _CMFALSE);
+    _CMREQUIRE(initial_capacity > 2, initial_capacity = 2);
+    cset_t *cset = callocator_alloc(allocator, sizeof(cset_t), 0);
+    _CMREQUIRE(cset, return _CMFALSE);
+    *cset = (cset_t){._buckets = NULL,
+                     ._pool = NULL,
+                     ._size = 0,
+                     ._capacity = _cmap_nexp2(initial_capacity),
+                     ._key_size = key_size,
+                     ._hash_func = hash_func,
+                     ._comparison_func = comparison_func,
+                     ._key_destructor = key_destructor,
+                     ._allocator = allocator};
+    _CMREQUIRE(
+        cpool_init_with(&cset->_pool, allocator),
+        callocator_free(allocator, cset, sizeof(cset_t));
+        return _CMFALSE
+    );
+    cset->_buckets = _cset_bucket_alloc(allocator, cset->_capacity);
+    _CMREQUIRE(
+        cset->_buckets, cpool_uninit(&cset->_pool);
+        callocator_free(allocator, cset, sizeof(cset_t));
+        return _CMFALSE
+    );
+    *set = cset;
+    return _CMTRUE;
+}
+
+// Initializes a given pointer with a cset_t instance.
+_CMSTCINL _Bool cset_init(
+    cset_t **set,
+    size_t key_size,
+    size_t initial_capacity,
+    size_t (*hash_func)(const void *),
+    int (*comparison_func)(const void *, const void *),
+    void (*key_destructor)(void **)
+) {
+    return cset_init_with(
+        set, key_size, initial_capacity, hash_func, comparison_func, key_destructor, NULL
+    );
+}
+
+// Uninitializes a pointer to a cset_t instance.
+_CMSTCINL void cset_uninit(cset_t **set) {
+    _CMREQUIRE(set && *set, return);
+    cset_t *cset = *set;
+    _CMFOR(i, 0, cset->_capacity, 1) {
+        cset_bucket_t *bucket = &cset->_buckets[i];
+        if (!bucket->_occupied || !cset->_key_destructor) {
+            continue;
+        }
+        const size_t tbkt_capacity = bucket->_overflow_capacity + _CS_INLINE_SIZE;
+        _CMFOR(j, 0, tbkt_capacity, 1) {
+            void **slot = _cset_bucket_key(bucket, j);
+            if (*slot != (void *)_CMSENTINEL) {
+                cset->_key_destructor(slot);
+            }
+        }
+    }
+    _cset_bucket_free(cset, cset->_buckets, cset->_capacity);
+    cpool_uninit(&cset->_pool);
+    callocator_free(cset->_allocator, cset, sizeof(cset_t));
+    *set = NULL;
+}
+
+// Resizes a given set to a given number of buckets.
+_CMSTCINL _Bool cset_resize(cset_t **set, size_t nsize) {
+    _CMREQUIRE(set && *set, return _CMFALSE);
+    return _cset_rehash(*set, _CMMAX(_cmap_nexp2(nsize), 2));
+}
+
+// Inserts a key into the set. If the key already exists, the set is left unchanged.
+_CMSTCINL _Bool cset_insert(cset_t **set, void *key) {
+    _CMREQUIRE(set && *set, return _CMFALSE);
+    cset_t *cset = *set;
+    if (cset->_size >= cset->_capacity * _CMLFACTOR_LIMIT) {
+        _cset_rehash(cset, cset->_capacity * 2);
+    }
+    cset_bucket_t *bucket = &cset->_buckets[cset->_hash_func(key) & (cset->_capacity - 1)];
+    _CMREQUIRE(!_cset_bucket_scan(cset, bucket, key), return _CMTRUE);
+    _CMREQUIRE(_cset_bucket_place(bucket, &cset->_pool, key), return _CMFALSE);
+    ++cset->_size;
+    return _CMTRUE;
+}
+
+// Returns whether the set holds a key.
+_CMSTCINL _Bool cset_contains(cset_t **set, const void *key) {
+    _CMREQUIRE(set && *set, return _CMFALSE);
+    cset_t *cset = *set;
+    cset_bucket_t *bucket = &cset->_buckets[cset->_hash_func(key) & (cset->_capacity - 1)];
+    return _cset_bucket_scan(cset, bucket, key) != NULL;
+}
+
+// Removes a specified key from the set.
+_CMSTCINL void cset_remove(cset_t **set, void *key) {
+    _CMREQUIRE(set && *set, return);
+    cset_t *cset = *set;
+    cset_bucket_t *bucket = &cset->_buckets[cset->_hash_func(key) & (cset->_capacity - 1)];
+    void **slot = _cset_bucket_scan(cset, bucket, key);
+    _CMREQUIRE(slot, return);
+    if (cset->_key_destructor) {
+        cset->_key_destructor(slot);
+    }
+    _cset_bucket_clear(cset, bucket, slot);
+    _cset_shrink(cset);
+}
+
+// Returns whether two sets can be combined, sharing their hash and comparison functions.
+_CMSTCINL _Bool _cset_compatible(const cset_t *a, const cset_t *b) {
+    return a != b && a->_hash_func == b->_hash_func && a->_comparison_func == b->_comparison_func;
+}
+
+/*
+    Returns the bucket of `peer` that would hold a key stored in bucket `idx` of a set with
+    `capacity` buckets. Both capacities are powers of two, so a peer that is not larger maps bucket
+    `idx` onto its bucket `idx & (peer->_capacity - 1)` without rehashing the key.
+*/
+_CMSTCINL cset_bucket_t *
+_cset_peer_bucket(const cset_t *peer, size_t idx, size_t capacity, const void *key) {
+    const size_t hash = peer->_capacity <= capacity ? idx : peer->_hash_func(key);
+    return &peer->_buckets[hash & (peer->_capacity - 1)];
+}
+
+// Removes every key of `cset` whose membership in `peer` differs from `keep_members`, bucket by
+// bucket.
+_CMSTCINL void _cset_filter(cset_t *cset, const cset_t *peer, _Bool keep_members) {
+    _CMFOR(i, 0, cset->_capacity, 1) {
+        cset_bucket_t *bucket = &cset->_buckets[i];
+        if (!bucket->_occupied) {
+            continue;
+        }
+        const size_t tbkt_capacity = bucket->_overflow_capacity + _CS_INLINE_SIZE;
+        _CMFOR(j, 0, tbkt_capacity, 1) {
+            void **slot = _cset_bucket_key(bucket, j);
+            if (*slot == (void *)_CMSENTINEL) {
+                continue;
+            }
+            cset_bucket_t *pbucket = _cset_peer_bucket(peer, i, cset->_capacity, *slot);
+            if ((_cset_bucket_scan(peer, pbucket, *slot) != NULL) == keep_members) {
+                continue;
+            }
+            if (cset->_key_destructor) {
+                cset->_key_destructor(slot);
+            }
+            _cset_bucket_clear(cset, bucket, slot);
+        }
+    }
+    _cset_shrink(cset);
+}
+
+/*
+    Moves every key of `src` into `dst`, leaving `src` empty. Keys that `dst` already holds are
+    destroyed with the key destructor of `src`. Both sets must share their hash and comparison
+    functions.
+
+    `dst` first grows to at least the capacity of `src`. Bucket `s` of a source as large as `dst`
+    then only feeds bucket `s` of `dst`, so keys move bucket by bucket without being rehashed.
+    On failure, returns `false` and leaves the keys that were not moved yet in `src`.
+*/
+_CMSTCINL _Bool cset_union(cset_t **dst, cset_t **src) {
+    _CMREQUIRE(dst && *dst && src && *src && _cset_compatible(*dst, *src), return _CMFALSE);
+    cset_t *to = *dst;
+    cset_t *from = *src;
+    size_t capacity = _CMMAX(to->_capacity, from->_capacity);
+    if (to->_size + from->_size >= capacity * _CMLFACTOR_LIMIT) {
+        capacity = _cset_fit_capacity(to->_size + from->_size); // As if the keys were disjoint.
+    }
+    if (capacity != to->_capacity) {
+        _CMREQUIRE(_cset_rehash(to, capacity), return _CMFALSE);
+    }
+    const _Bool aligned = from->_capacity == capacity;
+    _CMFOR(s, 0, from->_capacity, 1) {
+        cset_bucket_t *bucket = &from->_buckets[s];
+        if (!bucket->_occupied) {
+            continue;
+        }
+        const size_t tbkt_capacity = bucket->_overflow_capacity + _CS_INLINE_SIZE;
+        _CMFOR(j, 0, tbkt_capacity, 1) {
+            void **slot = _cset_bucket_key(bucket, j);
+            if (*slot == (void *)_CMSENTINEL) {
+                continue;
+            }
+            const size_t idx = aligned ? s : from->_hash_func(*slot) & (capacity - 1);
+            cset_bucket_t *target = &to->_buckets[idx];
+            if (!_cset_bucket_scan(to, target, *slot)) {
+                _CMREQUIRE(_cset_bucket_place(target, &to->_pool, *slot), return _CMFALSE);
+                ++to->_size;
+            } else if (from->_key_destructor) {
+                from->_key_destructor(slot);
+            }
+            _cset_bucket_clear(from, bucket, slot);
+        }
+    }
+    // Every bucket is empty by now, so their overflow storage is released along with its slabs.
+    cpool_reset(&from->_pool);
+    _CMFOR(s, 0, from->_capacity, 1) {
+        from->_buckets[s]._overflow_keys = NULL;
+        from->_buckets[s]._overflow_capacity = 0;
+    }
+    return _CMTRUE;
+}
+
+// Removes every key of `dst` that `src` does not hold, destroying it. Walks `dst` bucket by
+// bucket, probing the matching bucket of `src`. Both sets must share their hash and comparison
+// functions.
+_CMSTCINL _Bool cset_intersect(cset_t **dst, cset_t **src) {
+    _CMREQUIRE(dst && *dst && src && *src && _cset_compatible(*dst, *src), return _CMFALSE);
+    _cset_filter(*dst, *src, _CMTRUE);
+    return _CMTRUE;
+}
+
+// Removes every key of `dst` that `src` holds, destroying it. Walks `dst` bucket by bucket,
+// probing the matching bucket of `src`. Both sets must share their hash and comparison functions.
+_CMSTCINL _Bool cset_difference(cset_t **dst, cset_t **src) {
+    _CMREQUIRE(dst && *dst && src && *src && _cset_compatible(*dst, *src), return _CMFALSE);
+    _cset_filter(*dst, *src, _CMFALSE);
+    return _CMTRUE;
+}
+
+// Advances the iterator to the first key at or after its current position.
+_CMSTCINL _Bool _cset_iter_seek(cset_iterator_t *iter, void **out) {
+    cset_t *set = iter->set;
+    while (iter->bucket_idx < set->_capacity) {
+        cset_bucket_t *bucket = &set->_buckets[iter->bucket_idx];
+        const size_t tbkt_capacity = bucket->_overflow_capacity + _CS_INLINE_SIZE;
+        while (bucket->_occupied && iter->st_idx < tbkt_capacity) {
+            void *key = *_cset_bucket_key(bucket, iter->st_idx);
+            if (key != (void *)_CMSENTINEL) {
+                *out = key;
+                return _CMTRUE;
+            }
+            ++iter->st_idx;
+        }
+        ++iter->bucket_idx;
+        iter->st_idx = 0;
+    }
+    return _CMFALSE;
+}
+
+_CMSTCINL _Bool cset_iter_next(cset_iterator_t *iter, void **out) {
+    _CMREQUIRE(
+        iter && out && iter->set && iter->bucket_idx < iter->set->_capacity, return _CMFALSE
+    );
+    ++iter->st_idx; // Increment to possible next key.
+    return _cset_iter_seek(iter, out);
+}
+
+_CMSTCINL _Bool cset_iter_start(cset_t **set, cset_iterator_t *iter, void **out) {
+    _CMREQUIRE(set && *set && iter && out, return _CMFALSE);
+    _CMREQUIRE((*set)->_size > 0, return _CMFALSE);
+
+    iter->bucket_idx = 0;
+    iter->set = *set;
+    iter->st_idx = 0;
+    return _cset_iter_seek(iter, out);
+}
+
+// Macro API accessors.
+#define CSET_SIZE(set) (set->_size)
+#define CSET_CAPACITY(set) (set->_capacity)
+#define CSET_KEY_SIZE(set) (set->_key_size)
+#define CSET_HASH_FUNCTION(set) (set->_hash_func)
+#define CSET_CMP_FUNCTION(set) (set->_comparison_func)
+#define CSET_KEY_DESTRUCTOR(set) (set->_key_destructor)
+
+// Macro API functions.
+#define CSET_INIT(set, key_type, init_capacity, hash_func, cmp_func, kdtor)                        \
+    (cset_init(&set, sizeof(key_type), init_capacity, hash_func, cmp_func, kdtor))
+#define CSET_INIT_WITH(set, key_type, init_capacity, hash_func, cmp_func, kdtor, allocator)        \
+    (cset_init_with(&set, sizeof(key_type), init_capacity, hash_func, cmp_func, kdtor, allocator))
+#define CSET_UNINIT(set) (cset_uninit(&set))
+#define CSET_INSERT(set, key) (cset_insert(&set, (void *)key))
+#define CSET_REMOVE(set, key) (cset_remove(&set, (void *)key))
+#define CSET_CONTAINS(set, key) (cset_contains(&set, (const void *)key))
+#define CSET_RESIZE(set, nsize) (cset_resize(&set, nsize))
+#define CSET_UNION(dst, src) (cset_union(&dst, &src))
+#define CSET_INTERSECT(dst, src) (cset_intersect(&dst, &src))
+#define CSET_DIFFERENCE(dst, src) (cset_difference(&dst, &src))
+#define CSET_ITER_START(set, iter, out) (cset_iter_start(&set, &iter, (void **)&out))
+#define CSET_ITER_NEXT(iter, out) (cset_iter_next(&iter, (void **)&out))
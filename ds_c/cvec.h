@@ -10,6 +10,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "callocator.h"
+
 // Utility macros.
 #define _CVSTCINL static inline
 #define _CVREQUIRE(condition, action)                                                              \
@@ -22,12 +24,15 @@
 #define _CVTRUE 1
 #define _CVFOR(iter, start, end, step) for (size_t iter = (start); iter < (end); iter += (step))
 
-// Vector header data.
+// Vector header data. Aligned so that the elements following it are, too.
 typedef struct {
-    size_t _element_size;
+    _Alignas(max_align_t) size_t _element_size;
     size_t _capacity;
     size_t _size;
+    size_t _alignment; // Of the elements. At least `_Alignof(max_align_t)`.
     void (*_destructor)(void *);
+    const callocator_t *_allocator; // NULL for malloc().
+    _Bool _inline; // Lives in caller-provided storage (see CVEC_SMALL), which is never freed.
 } cvec_t;
 
 // Accessor macros
@@ -36,6 +41,15 @@ typedef struct {
 #define _CVSIZE(vec) (_CVHEADER(vec)->_size)
 #define _CVESIZE(vec) (_CVHEADER(vec)->_element_size)
 #define _CVDESTRUCTOR(vec) (_CVHEADER(vec)->_destructor)
+#define _CVALLOCATOR(vec) (_CVHEADER(vec)->_allocator)
+#define _CVALIGNMENT(vec) (_CVHEADER(vec)->_alignment)
+#define _CVINLINE(vec) (_CVHEADER(vec)->_inline)
+
+// The header sits right before the elements, padded at the front of the allocation up to the
+// alignment of the elements.
+#define _CVOFFSET(alignment) ((sizeof(cvec_t) + (alignment) - 1) & ~((alignment) - 1))
+#define _CVBLOCK(vec) ((char *)(vec) - _CVOFFSET(_CVALIGNMENT(vec)))
+#define _CVBYTES(vec) (_CVOFFSET(_CVALIGNMENT(vec)) + _CVCAPACITY(vec) * _CVESIZE(vec))
 
 _CVSTCINL size_t _cvec_nexp2(size_t n) {
     _CVREQUIRE(n, return 1);
@@ -55,25 +69,100 @@ _CVSTCINL size_t _cvec_nexp2(size_t n) {
     return n;
 }
 
-// Initializes a given vector with a header.
-_CVSTCINL _Bool cvec_init(
-    void **restrict vec, size_t element_size, size_t initial_capacity, void (*destructor)(void *)
+// Implementation detail. Initializes a vector whose elements are aligned to `alignment` (0 for
+// the default), allocating through `allocator`.
+_CVSTCINL _Bool _cvec_init(
+    void **restrict vec,
+    size_t element_size,
+    size_t initial_capacity,
+    size_t alignment,
+    void (*destructor)(void *),
+    const callocator_t *allocator
 ) {
+    _CVREQUIRE(!(alignment & (alignment - 1)), return _CVFALSE);
+    alignment = alignment > _Alignof(max_align_t) ? alignment : _Alignof(max_align_t);
+    const size_t offset = _CVOFFSET(alignment);
     _CVREQUIRE(
-        vec && element_size && initial_capacity < SIZE_MAX / element_size &&
-            SIZE_MAX - initial_capacity * element_size > sizeof(cvec_t),
+        vec && element_size && offset >= sizeof(cvec_t) &&
+            initial_capacity < SIZE_MAX / element_size &&
+            SIZE_MAX - initial_capacity * element_size > offset,
         return _CVFALSE
     );
-    cvec_t *cvec = (cvec_t *)malloc(sizeof(cvec_t) + element_size * initial_capacity);
-    _CVREQUIRE(cvec, return _CVFALSE);
+    char *block = callocator_alloc(allocator, offset + element_size * initial_capacity, alignment);
+    _CVREQUIRE(block, return _CVFALSE);
+    cvec_t *cvec = (cvec_t *)(block + offset) - 1;
     *cvec = (cvec_t){._element_size = element_size,
                      ._capacity = initial_capacity,
                      ._size = 0,
-                     ._destructor = destructor};
+                     ._alignment = alignment,
+                     ._destructor = destructor,
+                     ._allocator = allocator,
+                     ._inline = _CVFALSE};
+    *vec = ++cvec;
+    return _CVTRUE;
+}
+
+// Initializes a given vector with a header, allocating through `allocator` (NULL for malloc()).
+_CVSTCINL _Bool cvec_init_with(
+    void **restrict vec,
+    size_t element_size,
+    size_t initial_capacity,
+    void (*destructor)(void *),
+    const callocator_t *allocator
+) {
+    return _cvec_init(vec, element_size, initial_capacity, 0, destructor, allocator);
+}
+
+/*
+    Initializes a given vector whose elements are aligned to `alignment`, a power of two, such as
+    32 for AVX or 64 for AVX-512 aligned loads. The alignment holds across growth, which then
+    moves the elements to a new allocation instead of reallocating in place.
+*/
+_CVSTCINL _Bool cvec_init_aligned(
+    void **restrict vec,
+    size_t element_size,
+    size_t initial_capacity,
+    size_t alignment,
+    void (*destructor)(void *)
+) {
+    _CVREQUIRE(alignment, return _CVFALSE);
+    return _cvec_init(vec, element_size, initial_capacity, alignment, destructor, NULL);
+}
+
+/*
+    Initializes a given vector inside caller-provided storage of `storage_size` bytes, usually a
+    CVEC_SMALL() declared on the stack, which holds the header and as many elements as fit after
+    it. Nothing is allocated until the vector outgrows the storage, at which point it moves to the
+    heap. The storage must outlive the vector, or its spill to the heap.
+*/
+_CVSTCINL _Bool cvec_init_small(
+    void **restrict vec,
+    void *storage,
+    size_t storage_size,
+    size_t element_size,
+    void (*destructor)(void *)
+) {
+    _CVREQUIRE(vec && storage && element_size && storage_size >= sizeof(cvec_t), return _CVFALSE);
+    _CVREQUIRE((uintptr_t)storage % _Alignof(cvec_t) == 0, return _CVFALSE);
+    cvec_t *cvec = (cvec_t *)storage;
+    *cvec = (cvec_t){._element_size = element_size,
+                     ._capacity = (storage_size - sizeof(cvec_t)) / element_size,
+                     ._size = 0,
+                     ._alignment = _Alignof(max_align_t),
+                     ._destructor = destructor,
+                     ._allocator = NULL,
+                     ._inline = _CVTRUE};
     *vec = ++cvec;
     return _CVTRUE;
 }
 
+// Initializes a given vector with a header.
+_CVSTCINL _Bool cvec_init(
+    void **restrict vec, size_t element_size, size_t initial_capacity, void (*destructor)(void *)
+) {
+    return cvec_init_with(vec, element_size, initial_capacity, destructor, NULL);
+}
+
 // Uninitializes/destroys a vector along with its elements should a destructor be provided.
 _CVSTCINL void cvec_uninit(void **restrict vec) {
     _CVREQUIRE(vec && *vec, return);
@@ -81,7 +170,9 @@ _CVSTCINL void cvec_uninit(void **restrict vec) {
     if (cvec->_destructor) {
         _CVFOR(i, 0, _CVSIZE(*vec), 1) { cvec->_destructor((char *)*vec + i * _CVESIZE(*vec)); }
     }
-    free(cvec);
+    if (!cvec->_inline) {
+        callocator_free(cvec->_allocator, _CVBLOCK(*vec), _CVBYTES(*vec));
+    }
     *vec = NULL;
 }
 
@@ -90,15 +181,31 @@ _CVSTCINL _Bool cvec_reserve(void **restrict vec, size_t new_capacity) {
     _CVREQUIRE(vec && *vec, return _CVFALSE);
     _CVREQUIRE(new_capacity > _CVCAPACITY(*vec), return _CVTRUE);
     new_capacity = _cvec_nexp2(new_capacity);
+    const size_t alignment = _CVALIGNMENT(*vec);
+    const size_t offset = _CVOFFSET(alignment);
     _CVREQUIRE(
         SIZE_MAX / _CVESIZE(*vec) > new_capacity &&
-            SIZE_MAX - _CVESIZE(*vec) * new_capacity > sizeof(cvec_t),
+            SIZE_MAX - _CVESIZE(*vec) * new_capacity > offset,
         return _CVFALSE
     );
-    cvec_t *cvec = _CVHEADER(*vec);
-    cvec_t *tmp = (cvec_t *)realloc(cvec, sizeof(cvec_t) + _CVESIZE(*vec) * new_capacity);
-    _CVREQUIRE(tmp, return _CVFALSE);
+    const size_t new_bytes = offset + _CVESIZE(*vec) * new_capacity;
+    char *block = NULL;
+    if (_CVINLINE(*vec) || alignment > _Alignof(max_align_t)) {
+        // Inline storage spills to the heap, and a reallocated block only keeps the default
+        // alignment.
+        block = callocator_alloc(_CVALLOCATOR(*vec), new_bytes, alignment);
+        _CVREQUIRE(block, return _CVFALSE);
+        memcpy(block, _CVBLOCK(*vec), offset + _CVSIZE(*vec) * _CVESIZE(*vec));
+        if (!_CVINLINE(*vec)) {
+            callocator_free(_CVALLOCATOR(*vec), _CVBLOCK(*vec), _CVBYTES(*vec));
+        }
+    } else {
+        block = callocator_realloc(_CVALLOCATOR(*vec), _CVBLOCK(*vec), _CVBYTES(*vec), new_bytes);
+        _CVREQUIRE(block, return _CVFALSE);
+    }
+    cvec_t *tmp = (cvec_t *)(block + offset) - 1;
     tmp->_capacity = new_capacity;
+    tmp->_inline = _CVFALSE;
     *vec = ++tmp;
     return _CVTRUE;
 }
@@ -160,23 +267,140 @@ _CVSTCINL void cvec_clear(void **restrict vec) {
     _CVSIZE(*vec) = 0;
 }
 
-// Performs a shallow copy on a given vector.
+// Appends `count` elements to the end of the vector, reserving once. `elements` must not point
+// into the vector.
+_CVSTCINL _Bool
+cvec_append_range(void **restrict vec, const void *restrict elements, size_t count) {
+    _CVREQUIRE(vec && *vec && (elements || !count), return _CVFALSE);
+    _CVREQUIRE(count <= SIZE_MAX - _CVSIZE(*vec), return _CVFALSE);
+    _CVREQUIRE(cvec_reserve(vec, _CVSIZE(*vec) + count), return _CVFALSE);
+    if (count) {
+        memcpy((char *)*vec + _CVSIZE(*vec) * _CVESIZE(*vec), elements, count * _CVESIZE(*vec));
+    }
+    _CVSIZE(*vec) += count;
+    return _CVTRUE;
+}
+
+// Inserts `count` elements at a specified index of the vector, shifting the tail once. `elements`
+// must not point into the vector.
+_CVSTCINL _Bool cvec_insert_range(
+    void **restrict vec, size_t index, const void *restrict elements, size_t count
+) {
+    _CVREQUIRE(vec && *vec && (elements || !count) && index <= _CVSIZE(*vec), return _CVFALSE);
+    _CVREQUIRE(count <= SIZE_MAX - _CVSIZE(*vec), return _CVFALSE);
+    _CVREQUIRE(count, return _CVTRUE);
+    _CVREQUIRE(cvec_reserve(vec, _CVSIZE(*vec) + count), return _CVFALSE);
+    const size_t esize = _CVESIZE(*vec);
+    memmove(
+        (char *)*vec + (index + count) * esize, (char *)*vec + index * esize,
+        (_CVSIZE(*vec) - index) * esize
+    );
+    memcpy((char *)*vec + index * esize, elements, count * esize);
+    _CVSIZE(*vec) += count;
+    return _CVTRUE;
+}
+
+// Removes `count` elements starting at a specified index of the vector, shifting the tail once.
+_CVSTCINL void cvec_erase_range(void **restrict vec, size_t index, size_t count) {
+    _CVREQUIRE(vec && *vec && index <= _CVSIZE(*vec) && count <= _CVSIZE(*vec) - index, return);
+    const size_t esize = _CVESIZE(*vec);
+    if (_CVDESTRUCTOR(*vec)) {
+        _CVFOR(i, index, index + count, 1) { _CVDESTRUCTOR (*vec)((char *)*vec + i * esize); }
+    }
+    memmove(
+        (char *)*vec + index * esize, (char *)*vec + (index + count) * esize,
+        (_CVSIZE(*vec) - index - count) * esize
+    );
+    _CVSIZE(*vec) -= count;
+}
+
+// Sets the size of the vector. Removed elements are destroyed, and added ones are zeroed if
+// `zero_fill` is set, else left uninitialized.
+_CVSTCINL _Bool cvec_resize(void **restrict vec, size_t new_size, _Bool zero_fill) {
+    _CVREQUIRE(vec && *vec, return _CVFALSE);
+    const size_t size = _CVSIZE(*vec);
+    if (new_size <= size) {
+        cvec_erase_range(vec, new_size, size - new_size);
+        return _CVTRUE;
+    }
+    _CVREQUIRE(cvec_reserve(vec, new_size), return _CVFALSE);
+    if (zero_fill) {
+        memset((char *)*vec + size * _CVESIZE(*vec), 0, (new_size - size) * _CVESIZE(*vec));
+    }
+    _CVSIZE(*vec) = new_size;
+    return _CVTRUE;
+}
+
+// Implementation detail. Keeps the elements whose predicate result equals `keep`, in order, moving
+// each run of kept elements once. Returns the number of removed elements.
+_CVSTCINL size_t _cvec_compact(
+    void **restrict vec, _Bool (*predicate)(const void *, void *), void *ctx, _Bool keep
+) {
+    _CVREQUIRE(vec && *vec && predicate, return 0);
+    const size_t esize = _CVESIZE(*vec);
+    const size_t size = _CVSIZE(*vec);
+    char *data = (char *)*vec;
+    size_t write = 0;
+    size_t run = 0; // Start of the current run of kept elements.
+    _CVFOR(i, 0, size, 1) {
+        if (!predicate(data + i * esize, ctx) == !keep) {
+            continue;
+        }
+        if (run != i && write != run) {
+            memmove(data + write * esize, data + run * esize, (i - run) * esize);
+        }
+        write += i - run;
+        run = i + 1;
+        if (_CVDESTRUCTOR(*vec)) {
+            _CVDESTRUCTOR (*vec)(data + i * esize);
+        }
+    }
+    if (run != size && write != run) {
+        memmove(data + write * esize, data + run * esize, (size - run) * esize);
+    }
+    write += size - run;
+    _CVSIZE(*vec) = write;
+    return size - write;
+}
+
+// Removes every element the predicate holds for, in a single pass that keeps the order of the
+// rest. The predicate receives each element and `ctx`. Returns the number of removed elements.
+_CVSTCINL size_t
+cvec_erase_if(void **restrict vec, _Bool (*predicate)(const void *, void *), void *ctx) {
+    return _cvec_compact(vec, predicate, ctx, _CVFALSE);
+}
+
+// Keeps only the elements the predicate holds for, as the opposite of cvec_erase_if().
+_CVSTCINL size_t
+cvec_retain(void **restrict vec, _Bool (*predicate)(const void *, void *), void *ctx) {
+    return _cvec_compact(vec, predicate, ctx, _CVTRUE);
+}
+
+// Performs a shallow copy on a given vector. The copy shares the allocator and alignment of the
+// source.
 _CVSTCINL _Bool cvec_shlwcopy(void **restrict dst_vec, const void **restrict src_vec) {
     _CVREQUIRE(dst_vec && src_vec && *src_vec, return _CVFALSE);
-    *dst_vec = malloc(sizeof(cvec_t) + _CVCAPACITY(*src_vec) * _CVESIZE(*src_vec));
-    _CVREQUIRE(*dst_vec, return _CVFALSE);
-    memcpy(*dst_vec, _CVHEADER(*src_vec), sizeof(cvec_t) + _CVSIZE(*src_vec) * _CVESIZE(*src_vec));
-    ++*(cvec_t **)dst_vec;
+    const size_t offset = _CVOFFSET(_CVALIGNMENT(*src_vec));
+    char *block =
+        callocator_alloc(_CVALLOCATOR(*src_vec), _CVBYTES(*src_vec), _CVALIGNMENT(*src_vec));
+    _CVREQUIRE(block, return _CVFALSE);
+    memcpy(block, _CVBLOCK(*src_vec), offset + _CVSIZE(*src_vec) * _CVESIZE(*src_vec));
+    ((cvec_t *)(block + offset) - 1)->_inline = _CVFALSE;
+    *dst_vec = block + offset;
     return _CVTRUE;
 }
 
-// Performs a deep copy on a given vector.
+// Performs a deep copy on a given vector. The copy shares the allocator and alignment of the
+// source.
 _CVSTCINL _Bool cvec_dpcopy(
     void **restrict dst_vec, const void **restrict src_vec, _Bool (*copy_func)(void *, const void *)
 ) {
     _CVREQUIRE(dst_vec && src_vec && *src_vec, return _CVFALSE);
     _CVREQUIRE(
-        cvec_init(dst_vec, _CVESIZE(*src_vec), _CVCAPACITY(*src_vec), _CVDESTRUCTOR(*src_vec)),
+        _cvec_init(
+            dst_vec, _CVESIZE(*src_vec), _CVCAPACITY(*src_vec), _CVALIGNMENT(*src_vec),
+            _CVDESTRUCTOR(*src_vec), _CVALLOCATOR(*src_vec)
+        ),
         return _CVFALSE
     );
     _CVFOR(i, 0, _CVSIZE(*src_vec), 1) {
@@ -195,9 +419,23 @@ _CVSTCINL _Bool cvec_dpcopy(
 }
 
 // Macro API.
+// Declares storage for a vector of up to `n` elements kept inline, e.g. on the stack. Pair it with
+// CVEC_INIT_SMALL(). Elements must follow the header directly, so over-aligned types are refused.
+#define CVEC_SMALL(type, n)                                                                        \
+    struct {                                                                                       \
+        cvec_t _header;                                                                            \
+        type _elements[n];                                                                         \
+        _Static_assert(_Alignof(type) <= _Alignof(cvec_t), "CVEC_SMALL: over-aligned type");       \
+    }
 #if defined(__GNUC__) || defined(__clang__)
 #define CVEC_INIT(vec, init_capacity, destructor)                                                  \
     cvec_init((void **)&vec, sizeof(*vec), init_capacity, destructor)
+#define CVEC_INIT_WITH(vec, init_capacity, destructor, allocator)                                  \
+    cvec_init_with((void **)&vec, sizeof(*vec), init_capacity, destructor, allocator)
+#define CVEC_INIT_ALIGNED(vec, init_capacity, alignment, destructor)                               \
+    cvec_init_aligned((void **)&vec, sizeof(*vec), init_capacity, alignment, destructor)
+#define CVEC_INIT_SMALL(vec, storage, destructor)                                                  \
+    cvec_init_small((void **)&vec, &(storage), sizeof(storage), sizeof(*vec), destructor)
 #define CVEC_PUSHBACK(vec, element)                                                                \
     cvec_pushback((void **)&vec, (const void *)&(typeof(*vec)){element})
 #define CVEC_INSERT(vec, index, element)                                                           \
@@ -205,6 +443,12 @@ _CVSTCINL _Bool cvec_dpcopy(
 #else
 #define CVEC_INIT(type, vec, init_capacity, destructor)                                            \
     cvec_init((void **)&vec, sizeof(*vec), init_capacity, destructor)
+#define CVEC_INIT_WITH(type, vec, init_capacity, destructor, allocator)                            \
+    cvec_init_with((void **)&vec, sizeof(*vec), init_capacity, destructor, allocator)
+#define CVEC_INIT_ALIGNED(type, vec, init_capacity, alignment, destructor)                         \
+    cvec_init_aligned((void **)&vec, sizeof(*vec), init_capacity, alignment, destructor)
+#define CVEC_INIT_SMALL(type, vec, storage, destructor)                                            \
+    cvec_init_small((void **)&vec, &(storage), sizeof(storage), sizeof(*vec), destructor)
 #define CVEC_PUSHBACK(type, vec, element)                                                          \
     cvec_pushback((void **)&vec, (const void *)&(type){element})
 #define CVEC_INSERT(type, vec, index, element)                                                     \
@@ -215,9 +459,20 @@ _CVSTCINL _Bool cvec_dpcopy(
 #define CVEC_CAPACITY(vec) _CVCAPACITY(vec)
 #define CVEC_ESIZE(vec) _CVESIZE(vec)
 #define CVEC_DESTRUCTOR(vec) _CVDESTRUCTOR(vec)
+#define CVEC_ALLOCATOR(vec) _CVALLOCATOR(vec)
+#define CVEC_ALIGNMENT(vec) _CVALIGNMENT(vec)
+#define CVEC_INLINE(vec) _CVINLINE(vec)
 #define CVEC_UNINIT(vec) cvec_uninit((void **)&vec)
 #define CVEC_POPBACK(vec) cvec_popback((void **)&vec)
 #define CVEC_REMOVE(vec, index) cvec_remove((void **)&vec, index)
 #define CVEC_CLEAR(vec) cvec_clear((void **)&vec)
 #define CVEC_SCOPY(dst, src) cvec_shlwcopy((void **)&dst, (const void **)&src)
-#define CVEC_DCOPY(dst, src, cpy_func) cvec_dpcopy((void **)&dst, (const void **)&src, cpy_func)
\ No newline at end of file
+#define CVEC_DCOPY(dst, src, cpy_func) cvec_dpcopy((void **)&dst, (const void **)&src, cpy_func)
+#define CVEC_APPEND_RANGE(vec, elements, count)                                                    \
+    cvec_append_range((void **)&vec, (const void *)(elements), count)
+#define CVEC_INSERT_RANGE(vec, index, elements, count)                                             \
+    cvec_insert_range((void **)&vec, index, (const void *)(elements), count)
+#define CVEC_ERASE_RANGE(vec, index, count) cvec_erase_range((void **)&vec, index, count)
+#define CVEC_RESIZE(vec, size, zero_fill) cvec_resize((void **)&vec, size, zero_fill)
+#define CVEC_ERASE_IF(vec, predicate, ctx) cvec_erase_if((void **)&vec, predicate, ctx)
+#define CVEC_RETAIN(vec, predicate, ctx) cvec_retain((void **)&vec, predicate, ctx)
\ No newline at end of file
@@ -0,0 +1,227 @@
+/*  cvec_mapped.h
+ *  File-backed cvec.h vectors, whose header and elements live in a shared memory mapping.
+ *  Requires POSIX mmap (e.g. -std=gnu11, or _POSIX_C_SOURCE >= 200112L with -std=c11, which this
+ *  header defines itself when included first).
+ *  https://github.com/a22Dv/c-dsa
+ */
+
+#pragma once
+
+// Strict ISO modes (e.g. -std=c11) hide POSIX. Takes effect when included before system headers.
+#if defined(__STRICT_ANSI__) && !defined(_POSIX_C_SOURCE) && !defined(_XOPEN_SOURCE) &&            \
+    !defined(_GNU_SOURCE) && !defined(_DEFAULT_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "cvec.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define _CVM_MAGIC "CVECMAP"
+#define _CVM_VERSION 1u
+#define _CVM_BYTE_ORDER 0x0102030405060708ULL // Reads back differently on a foreign byte order.
+#define _CVM_PREFIX ((size_t)64) // File header bytes, keeping the mapped cvec_t header aligned.
+
+// Access patterns for cvec_advise().
+typedef enum {
+    CVEC_ADVISE_NORMAL = 0,
+    CVEC_ADVISE_SEQUENTIAL, // Reads ahead aggressively, and pages behind may be dropped early.
+    CVEC_ADVISE_RANDOM,     // Disables read-ahead.
+    CVEC_ADVISE_WILLNEED,   // Starts paging in the whole vector.
+    CVEC_ADVISE_DONTNEED,   // The vector will not be accessed soon.
+} cvec_advice_t;
+
+/*
+    On-disk header, followed at `_CVM_PREFIX` by the vector's cvec_t header and its elements, as
+    they are laid out in memory. The layout of cvec_t is native, so files only reopen on machines
+    with the same byte order and word size.
+*/
+typedef struct {
+    char magic[8];
+    uint64_t byte_order;
+    uint32_t version;
+    uint8_t word_size;   // sizeof(size_t) of the producer.
+    uint8_t header_size; // sizeof(cvec_t) of the producer.
+    uint16_t _reserved;
+    uint64_t element_size;
+} cvec_mapped_header_t;
+
+// Mapping state. Its allocator is installed into the vector's header, with itself as the context,
+// so that cvec_reserve() grows the file and cvec_uninit() unmaps it.
+typedef struct {
+    callocator_t _allocator;
+    uint8_t *_base;
+    size_t _length;
+    int _fd;
+} cvec_mapped_t;
+
+// Copies of a mapped vector cannot live in its file.
+_CVSTCINL void *_cvec_mapped_alloc(void *ctx, size_t size, size_t align) {
+    (void)ctx;
+    (void)size;
+    (void)align;
+    return NULL;
+}
+
+// Grows the file, then the mapping. Elements are never copied: if the mapping cannot grow in
+// place, the file is mapped again at a larger length and the old mapping dropped.
+_CVSTCINL void *_cvec_mapped_realloc(void *ctx, void *block, size_t old_size, size_t new_size) {
+    cvec_mapped_t *mapped = (cvec_mapped_t *)ctx;
+    (void)old_size;
+    _CVREQUIRE(block && new_size <= SIZE_MAX - _CVM_PREFIX, return NULL);
+    const size_t length = _CVM_PREFIX + new_size;
+    if (length <= mapped->_length) {
+        return block;
+    }
+    _CVREQUIRE((off_t)length > 0 && ftruncate(mapped->_fd, (off_t)length) == 0, return NULL);
+#if defined(MREMAP_MAYMOVE)
+    void *base = mremap(mapped->_base, mapped->_length, length, MREMAP_MAYMOVE);
+    _CVREQUIRE(base != MAP_FAILED, return NULL);
+#else
+    void *base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, mapped->_fd, 0);
+    _CVREQUIRE(base != MAP_FAILED, return NULL);
+    munmap(mapped->_base, mapped->_length);
+#endif
+    mapped->_base = (uint8_t *)base;
+    mapped->_length = length;
+    return mapped->_base + _CVM_PREFIX;
+}
+
+// Unmaps and closes the file, which keeps the vector for a later cvec_map().
+_CVSTCINL void _cvec_mapped_free(void *ctx, void *block, size_t size) {
+    cvec_mapped_t *mapped = (cvec_mapped_t *)ctx;
+    (void)block;
+    (void)size;
+    munmap(mapped->_base, mapped->_length);
+    close(mapped->_fd);
+    free(mapped);
+}
+
+// Implementation detail. Returns the mapping state of a vector opened by cvec_map(), recognized by
+// the allocator it installed, or `NULL` for any other vector.
+_CVSTCINL cvec_mapped_t *_cvec_mapped(const void *vec) {
+    const callocator_t *allocator = _CVALLOCATOR(vec);
+    _CVREQUIRE(allocator && allocator->alloc_func == _cvec_mapped_alloc, return NULL);
+    return (cvec_mapped_t *)allocator->ctx;
+}
+
+// Checks the headers of an existing file against the expected element size and the file length.
+_CVSTCINL _Bool _cvec_mapped_valid(const uint8_t *base, size_t length, size_t element_size) {
+    _CVREQUIRE(length >= _CVM_PREFIX + sizeof(cvec_t), return _CVFALSE);
+    const cvec_mapped_header_t *file = (const cvec_mapped_header_t *)base;
+    const cvec_t *header = (const cvec_t *)(base + _CVM_PREFIX);
+    return memcmp(file->magic, _CVM_MAGIC, sizeof(file->magic)) == 0 &&
+           file->byte_order == _CVM_BYTE_ORDER && file->version == _CVM_VERSION &&
+           file->word_size == sizeof(size_t) && file->header_size == sizeof(cvec_t) &&
+           file->element_size == element_size && header->_element_size == element_size &&
+           header->_alignment == _Alignof(max_align_t) && header->_size <= header->_capacity &&
+           header->_capacity <= (length - _CVM_PREFIX - sizeof(cvec_t)) / element_size;
+}
+
+/*
+    Opens the vector stored at `path` into a given vector pointer, with no copy: the header and
+    elements are used where they are mapped. A missing or empty file is created with room for
+    `initial_capacity` elements. Fails if an existing file was not written by cvec_map() for
+    elements of the same size on a compatible machine.
+    The vector works with every cvec function but the copies. Growth extends the file and the
+    mapping, which may move, and cvec_uninit() unmaps the file, keeping its contents. Elements are
+    plain bytes in the file, so they take no destructor and should not hold pointers. Changes
+    reach the file eventually, and durably once cvec_sync() returns.
+*/
+_CVSTCINL _Bool
+cvec_map(void **restrict vec, const char *path, size_t element_size, size_t initial_capacity) {
+    _CVREQUIRE(vec && path && element_size, return _CVFALSE);
+    _CVREQUIRE(
+        initial_capacity < SIZE_MAX / element_size &&
+            SIZE_MAX - initial_capacity * element_size > _CVM_PREFIX + sizeof(cvec_t),
+        return _CVFALSE
+    );
+    cvec_mapped_t *mapped = malloc(sizeof(cvec_mapped_t));
+    _CVREQUIRE(mapped, return _CVFALSE);
+    mapped->_fd = open(path, O_RDWR | O_CREAT, 0644);
+    _CVREQUIRE(mapped->_fd >= 0, free(mapped); return _CVFALSE);
+    struct stat st;
+    _Bool ok = fstat(mapped->_fd, &st) == 0 && st.st_size >= 0 &&
+               (uintmax_t)st.st_size <= SIZE_MAX;
+    const _Bool created = ok && st.st_size == 0;
+    mapped->_length = ok ? (size_t)st.st_size : 0;
+    if (created) {
+        mapped->_length = _CVM_PREFIX + sizeof(cvec_t) + initial_capacity * element_size;
+        ok = (off_t)mapped->_length > 0 && ftruncate(mapped->_fd, (off_t)mapped->_length) == 0;
+    }
+    void *base = MAP_FAILED;
+    if (ok && mapped->_length) {
+        base = mmap(NULL, mapped->_length, PROT_READ | PROT_WRITE, MAP_SHARED, mapped->_fd, 0);
+    }
+    mapped->_base = (uint8_t *)base;
+    ok = base != MAP_FAILED &&
+         (created || _cvec_mapped_valid(mapped->_base, mapped->_length, element_size));
+    if (!ok) {
+        if (base != MAP_FAILED) {
+            munmap(base, mapped->_length);
+        }
+        close(mapped->_fd);
+        free(mapped);
+        return _CVFALSE;
+    }
+    mapped->_allocator = (callocator_t){.alloc_func = _cvec_mapped_alloc,
+                                        .realloc_func = _cvec_mapped_realloc,
+                                        .free_func = _cvec_mapped_free,
+                                        .ctx = mapped};
+    cvec_t *header = (cvec_t *)(mapped->_base + _CVM_PREFIX);
+    if (created) {
+        cvec_mapped_header_t file = {
+            .magic = _CVM_MAGIC,
+            .byte_order = _CVM_BYTE_ORDER,
+            .version = _CVM_VERSION,
+            .word_size = (uint8_t)sizeof(size_t),
+            .header_size = (uint8_t)sizeof(cvec_t),
+            ._reserved = 0,
+            .element_size = element_size,
+        };
+        memcpy(mapped->_base, &file, sizeof(file));
+        *header = (cvec_t){._element_size = element_size,
+                           ._capacity = initial_capacity,
+                           ._size = 0,
+                           ._alignment = _Alignof(max_align_t)};
+    }
+    // Pointers stored in the file are stale, so they are installed anew on every open.
+    header->_destructor = NULL;
+    header->_allocator = &mapped->_allocator;
+    header->_inline = _CVFALSE;
+    *vec = header + 1;
+    return _CVTRUE;
+}
+
+// Flushes a mapped vector's header and elements to its file. With `wait`, returns once they are
+// durable, else only schedules the writes. Returns `false` for vectors not opened by cvec_map().
+_CVSTCINL _Bool cvec_sync(void **restrict vec, _Bool wait) {
+    _CVREQUIRE(vec && *vec, return _CVFALSE);
+    cvec_mapped_t *mapped = _cvec_mapped(*vec);
+    _CVREQUIRE(mapped, return _CVFALSE);
+    return msync(mapped->_base, mapped->_length, wait ? MS_SYNC : MS_ASYNC) == 0;
+}
+
+// Tells the kernel how a mapped vector is about to be accessed, e.g. CVEC_ADVISE_SEQUENTIAL
+// before a scan. Only a hint, so the vector behaves the same either way. Returns `false` for
+// vectors not opened by cvec_map().
+_CVSTCINL _Bool cvec_advise(void **restrict vec, cvec_advice_t advice) {
+    _CVREQUIRE(vec && *vec, return _CVFALSE);
+    static const int advices[] = {
+        POSIX_MADV_NORMAL,   POSIX_MADV_SEQUENTIAL, POSIX_MADV_RANDOM,
+        POSIX_MADV_WILLNEED, POSIX_MADV_DONTNEED,
+    };
+    _CVREQUIRE(advice <= CVEC_ADVISE_DONTNEED, return _CVFALSE);
+    cvec_mapped_t *mapped = _cvec_mapped(*vec);
+    _CVREQUIRE(mapped, return _CVFALSE);
+    return posix_madvise(mapped->_base, mapped->_length, advices[advice]) == 0;
+}
+
+// Macro API functions.
+#define CVEC_MAP(vec, path, init_capacity)                                                         \
+    cvec_map((void **)&vec, path, sizeof(*vec), init_capacity)
+#define CVEC_SYNC(vec, wait) cvec_sync((void **)&vec, wait)
+#define CVEC_ADVISE(vec, advice) cvec_advise((void **)&vec, advice)